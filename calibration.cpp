@@ -0,0 +1,50 @@
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <opencv2/opencv.hpp>
+#include "calibration.h"
+
+std::vector<cv::Point3f> createBoardPoints(int patternWidth, int patternHeight)
+{
+    std::vector<cv::Point3f> objectPoints;
+    objectPoints.reserve(patternWidth * patternHeight);
+    for (int y = 0; y < patternHeight; ++y)
+    {
+        for (int x = 0; x < patternWidth; ++x)
+        {
+            objectPoints.emplace_back(static_cast<float>(x), static_cast<float>(y), 0.0f);
+        }
+    }
+    return objectPoints;
+}
+
+bool detectChessboard(const cv::Mat &frame, const cv::Size &patternSize, std::vector<cv::Point2f> &corners)
+{
+    cv::Mat greyScale;
+    if (frame.channels() == 3)
+        cv::cvtColor(frame, greyScale, cv::COLOR_BGR2GRAY);
+    else
+        greyScale = frame;
+
+    bool found = cv::findChessboardCorners(greyScale, patternSize, corners, cv::CALIB_CB_ADAPTIVE_THRESH + cv::CALIB_CB_NORMALIZE_IMAGE);
+    if (!found)
+        corners.clear();
+    return found;
+}
+
+void computeCornerErrors(const std::vector<cv::Point3f> &objectPoints, const std::vector<cv::Point2f> &imagePoints, const cv::Mat &rotationVec, const cv::Mat &translationVec, const cv::Mat &cameraIntrinsics, const cv::Mat &cameraDistortion, double &rmsError, double &maxError)
+{
+    std::vector<cv::Point2f> projectedPoints;
+    cv::projectPoints(objectPoints, rotationVec, translationVec, cameraIntrinsics, cameraDistortion, projectedPoints);
+
+    double sumSquared = 0;
+    maxError = 0;
+    for (size_t i = 0; i < projectedPoints.size(); i++)
+    {
+        double dx = imagePoints[i].x - projectedPoints[i].x;
+        double dy = imagePoints[i].y - projectedPoints[i].y;
+        sumSquared += dx * dx + dy * dy;
+        maxError = std::max(maxError, std::sqrt(dx * dx + dy * dy));
+    }
+    rmsError = projectedPoints.empty() ? 0.0 : std::sqrt(sumSquared / projectedPoints.size());
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <opencv2/opencv.hpp>
+
+// chessboard corners in board coordinates, one unit per square
+std::vector<cv::Point3f> createBoardPoints(int patternWidth, int patternHeight);
+
+// accepts BGR or greyscale frames, corners are left empty if the board was not found
+bool detectChessboard(const cv::Mat &frame, const cv::Size &patternSize, std::vector<cv::Point2f> &corners);
+
+// RMS and largest corner distance in pixels for a single frame
+void computeCornerErrors(const std::vector<cv::Point3f> &objectPoints, const std::vector<cv::Point2f> &imagePoints, const cv::Mat &rotationVec, const cv::Mat &translationVec, const cv::Mat &cameraIntrinsics, const cv::Mat &cameraDistortion, double &rmsError, double &maxError);
+
+// nearest rank percentile of already sorted values, fraction in [0, 1]
+template <typename T>
+double percentile(const std::vector<T> &sortedValues, double fraction)
+{
+    if (sortedValues.empty())
+        return 0.0;
+    size_t index = static_cast<size_t>(std::ceil(fraction * sortedValues.size()));
+    return sortedValues[std::min(sortedValues.size() - 1, index > 0 ? index - 1 : 0)];
+}
@@ -33,20 +33,28 @@ FragColor = texture ( texture1 , vec2(TexCoord.x, TexCoord.y) ) ;
 std::string objectVertexShader = R"(
 #version 330 core
 layout ( location = 0) in vec3 aPos ;
+layout ( location = 1) in vec3 aNormal ;
+layout ( location = 2) in mat4 aModel ;
 
 uniform mat4 view ;
 uniform mat4 projection ;
 
+out vec3 Normal ;
+
 void main () {
-gl_Position =  projection * view * vec4 ( aPos , 1.0) ;
+gl_Position =  projection * view * aModel * vec4 ( aPos , 1.0) ;
+Normal = mat3 ( view * aModel ) * aNormal ;
 }
 )";
 
 std::string objectFragmentShader = R"(
 #version 330 core
 out vec4 FragColor ;
+in vec3 Normal ;
 void main () {
-FragColor = vec4 (0.0 , 0.0 , 1.0 , 1.0) ;
+// headlight shading, so surfaces facing the camera are brightest
+float shade = 0.4 + 0.6 * abs ( normalize ( Normal ).z ) ;
+FragColor = vec4 (0.0 , 0.0 , shade , 1.0) ;
 }
 )";
 
@@ -140,10 +148,17 @@ unsigned int createShaderProgram(const std::string& vertexShader, const std::str
 unsigned int screenShaderProgram;
 unsigned int objectShaderProgram;
 
+int objectViewLocation;
+int objectProjectionLocation;
+
 void initShaderPrograms()
 {    
     screenShaderProgram = createShaderProgram(screenVertexShader, screenFragmentShader);
     objectShaderProgram = createShaderProgram(objectVertexShader, objectFragmentShader);
+
+    // cache uniform locations once instead of looking them up every frame
+    objectViewLocation = glGetUniformLocation(objectShaderProgram, "view");
+    objectProjectionLocation = glGetUniformLocation(objectShaderProgram, "projection");
 }
 
 void cleanupShaderPrograms()
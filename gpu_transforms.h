@@ -21,5 +21,8 @@ unsigned int createShaderProgram(const std::string& vertexShader, const std::str
 extern unsigned int screenShaderProgram;
 extern unsigned int objectShaderProgram;
 
+extern int objectViewLocation;
+extern int objectProjectionLocation;
+
 void initShaderPrograms();
 void cleanupShaderPrograms();
\ No newline at end of file
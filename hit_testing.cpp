@@ -0,0 +1,302 @@
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <opencv2/opencv.hpp>
+#include <glm/glm.hpp>
+#include "hit_testing.h"
+
+// same clipping planes as getProjectionMatrix
+const float nearPlane = 0.1f;
+const float farPlane = 100.0f;
+
+static void getPose(const cv::Mat& rotationVec, const cv::Mat& translationVec, glm::mat3& rotation, glm::vec3& translation)
+{
+    cv::Mat R_cv;
+    cv::Rodrigues(rotationVec, R_cv);
+    cv::Mat t_cv = translationVec.reshape(1, 3);
+
+    for (int r = 0; r < 3; r++)
+    {
+        for (int c = 0; c < 3; c++)
+            rotation[c][r] = static_cast<float>(R_cv.at<double>(r, c));
+        translation[r] = static_cast<float>(t_cv.at<double>(r));
+    }
+}
+
+bool fitDepthScale(const cv::Mat& depthMap, const std::vector<cv::Point2f>& imagePoints, const std::vector<cv::Point3f>& objectPoints, const cv::Mat& rotationVec, const cv::Mat& translationVec, float& scale, float& offset)
+{
+    glm::mat3 rotation;
+    glm::vec3 translation;
+    getPose(rotationVec, translationVec, rotation, translation);
+
+    // the depth network predicts relative disparity, so fit inverse depth = scale * value + offset
+    // against the camera space depth of the chessboard corners
+    double n = 0, sumD = 0, sumDD = 0, sumZ = 0, sumDZ = 0;
+    for (size_t i = 0; i < imagePoints.size() && i < objectPoints.size(); i++)
+    {
+        int x = cvRound(imagePoints[i].x);
+        int y = cvRound(imagePoints[i].y);
+        if (x < 0 || y < 0 || x >= depthMap.cols || y >= depthMap.rows)
+            continue;
+
+        double value = depthMap.at<unsigned char>(y, x);
+        glm::vec3 corner = rotation * glm::vec3(objectPoints[i].x, objectPoints[i].y, objectPoints[i].z) + translation;
+        if (value <= 0 || corner.z <= nearPlane)
+            continue;
+
+        double inverseDepth = 1.0 / corner.z;
+        n++;
+        sumD += value;
+        sumDD += value * value;
+        sumZ += inverseDepth;
+        sumDZ += value * inverseDepth;
+    }
+
+    if (n < 3 || sumDD <= 0)
+        return false;
+
+    // a flat board seen head on barely varies in depth, fall back to a pure scale in that case
+    double determinant = n * sumDD - sumD * sumD;
+    if (determinant / (n * n) > 1.0)
+    {
+        scale = static_cast<float>((n * sumDZ - sumD * sumZ) / determinant);
+        offset = static_cast<float>((sumZ - scale * sumD) / n);
+        if (scale > 0)
+            return true;
+    }
+
+    scale = static_cast<float>(sumDZ / sumDD);
+    offset = 0.0f;
+    return scale > 0;
+}
+
+cv::Mat toMetricDepth(const cv::Mat& depthMap, float scale, float offset)
+{
+    cv::Mat metricDepth(depthMap.size(), CV_32F);
+    for (int y = 0; y < depthMap.rows; y++)
+    {
+        const unsigned char* src = depthMap.ptr<unsigned char>(y);
+        float* dst = metricDepth.ptr<float>(y);
+        for (int x = 0; x < depthMap.cols; x++)
+        {
+            float inverseDepth = scale * src[x] + offset;
+            dst[x] = inverseDepth > 1.0f / farPlane ? 1.0f / inverseDepth : farPlane;
+        }
+    }
+    return metricDepth;
+}
+
+void buildDepthPyramid(const cv::Mat& metricDepth, DepthPyramid& pyramid)
+{
+    pyramid.minLevels.clear();
+    pyramid.maxLevels.clear();
+    pyramid.minLevels.push_back(metricDepth);
+    pyramid.maxLevels.push_back(metricDepth);
+
+    while (pyramid.minLevels.back().cols > 1 || pyramid.minLevels.back().rows > 1)
+    {
+        const cv::Mat& fineMin = pyramid.minLevels.back();
+        const cv::Mat& fineMax = pyramid.maxLevels.back();
+        cv::Mat coarseMin((fineMin.rows + 1) / 2, (fineMin.cols + 1) / 2, CV_32F);
+        cv::Mat coarseMax(coarseMin.size(), CV_32F);
+
+        // every coarse cell covers up to 2x2 fine cells, odd borders only have one
+        for (int y = 0; y < coarseMin.rows; y++)
+        {
+            int y0 = 2 * y;
+            int y1 = std::min(y0 + 1, fineMin.rows - 1);
+            for (int x = 0; x < coarseMin.cols; x++)
+            {
+                int x0 = 2 * x;
+                int x1 = std::min(x0 + 1, fineMin.cols - 1);
+                coarseMin.at<float>(y, x) = std::min({fineMin.at<float>(y0, x0), fineMin.at<float>(y0, x1), fineMin.at<float>(y1, x0), fineMin.at<float>(y1, x1)});
+                coarseMax.at<float>(y, x) = std::max({fineMax.at<float>(y0, x0), fineMax.at<float>(y0, x1), fineMax.at<float>(y1, x0), fineMax.at<float>(y1, x1)});
+            }
+        }
+
+        pyramid.minLevels.push_back(coarseMin);
+        pyramid.maxLevels.push_back(coarseMax);
+    }
+}
+
+bool fitDepthKeyframe(const cv::Mat& depthMap, const cv::Size& frameSize, const std::vector<cv::Point2f>& imagePoints, const std::vector<cv::Point3f>& objectPoints, const cv::Mat& rotationVec, const cv::Mat& translationVec, DepthKeyframe& keyframe)
+{
+    keyframe = DepthKeyframe();
+    if (depthMap.empty() || frameSize.width <= 0 || frameSize.height <= 0)
+        return false;
+
+    // sample the depth map at the corners instead of resizing it to the frame
+    std::vector<cv::Point2f> depthPoints(imagePoints.size());
+    for (size_t i = 0; i < imagePoints.size(); i++)
+    {
+        depthPoints[i].x = imagePoints[i].x * depthMap.cols / frameSize.width;
+        depthPoints[i].y = imagePoints[i].y * depthMap.rows / frameSize.height;
+    }
+
+    float scale, offset;
+    if (!fitDepthScale(depthMap, depthPoints, objectPoints, rotationVec, translationVec, scale, offset))
+        return false;
+
+    keyframe.depthMap = depthMap;
+    keyframe.frameSize = frameSize;
+    keyframe.scale = scale;
+    keyframe.offset = offset;
+    keyframe.fitted = true;
+    keyframe.rotationVec = rotationVec.clone();
+    keyframe.translationVec = translationVec.clone();
+    return true;
+}
+
+bool buildKeyframePyramid(DepthKeyframe& keyframe)
+{
+    if (!keyframe.fitted)
+        return false;
+    if (!keyframe.pyramid.minLevels.empty())
+        return true;
+
+    // hit testing works in frame pixel coordinates
+    cv::Mat resizedDepth = keyframe.depthMap;
+    if (resizedDepth.size() != keyframe.frameSize)
+        cv::resize(keyframe.depthMap, resizedDepth, keyframe.frameSize, 0, 0, cv::INTER_NEAREST);
+
+    buildDepthPyramid(toMetricDepth(resizedDepth, keyframe.scale, keyframe.offset), keyframe.pyramid);
+    return true;
+}
+
+bool hitTestDepth(const DepthKeyframe& keyframe, const cv::Mat& cameraIntrinsics, const cv::Mat& rotationVec, const cv::Mat& translationVec, const cv::Point2f& pixel, glm::vec3& worldHit, float thickness)
+{
+    if (keyframe.pyramid.minLevels.empty())
+        return false;
+
+    float fx = cameraIntrinsics.at<double>(0, 0);
+    float fy = cameraIntrinsics.at<double>(1, 1);
+    float cx = cameraIntrinsics.at<double>(0, 2);
+    float cy = cameraIntrinsics.at<double>(1, 2);
+
+    glm::mat3 frameRotation, keyframeRotation;
+    glm::vec3 frameTranslation, keyframeTranslation;
+    getPose(rotationVec, translationVec, frameRotation, frameTranslation);
+    getPose(keyframe.rotationVec, keyframe.translationVec, keyframeRotation, keyframeTranslation);
+
+    // ray through the clicked pixel in world coordinates
+    glm::vec3 worldOrigin = -glm::transpose(frameRotation) * frameTranslation;
+    glm::vec3 worldDirection = glm::transpose(frameRotation) * glm::vec3((pixel.x - cx) / fx, (pixel.y - cy) / fy, 1.0f);
+
+    // the same ray in the camera of the depth keyframe, p(t) = o + t * d
+    glm::vec3 o = keyframeRotation * worldOrigin + keyframeTranslation;
+    glm::vec3 d = keyframeRotation * worldDirection;
+
+    // clip the ray against the keyframe frustum, every bound is linear in t: a + t * b >= 0
+    float width = keyframe.pyramid.minLevels[0].cols;
+    float height = keyframe.pyramid.minLevels[0].rows;
+    float tStart = 0.0f;
+    float tEnd = farPlane;
+    auto clip = [&](float a, float b)
+    {
+        if (b == 0.0f)
+        {
+            if (a < 0.0f)
+                tEnd = -1.0f;
+            return;
+        }
+        if (b > 0.0f)
+            tStart = std::max(tStart, -a / b);
+        else
+            tEnd = std::min(tEnd, -a / b);
+    };
+    clip(o.z - nearPlane, d.z);
+    clip(fx * o.x + cx * o.z, fx * d.x + cx * d.z);
+    clip((width - cx) * o.z - fx * o.x, (width - cx) * d.z - fx * d.x);
+    clip(fy * o.y + cy * o.z, fy * d.y + cy * d.z);
+    clip((height - cy) * o.z - fy * o.y, (height - cy) * d.z - fy * d.y);
+    if (tStart >= tEnd)
+        return false;
+
+    // the projected ray is a line, so its direction in the keyframe image never changes sign
+    float stepX = (d.x * o.z - o.x * d.z > 0.0f) ? 1.0f : ((d.x * o.z - o.x * d.z < 0.0f) ? -1.0f : 0.0f);
+    float stepY = (d.y * o.z - o.y * d.z > 0.0f) ? 1.0f : ((d.y * o.z - o.y * d.z < 0.0f) ? -1.0f : 0.0f);
+
+    // walk the pyramid: skip whole cells the ray passes in front of (or far behind) and
+    // only descend into cells whose depth range the ray overlaps
+    int maxLevel = static_cast<int>(keyframe.pyramid.minLevels.size()) - 1;
+    int level = 0;
+    float t = tStart;
+
+    // a miss always advances t, the cap only guards against degenerate poses; a ray crosses at most
+    // width + height pixels and climbs and descends about twice per pixel
+    int maxIterations = 4 * static_cast<int>(width + height) + 2 * maxLevel;
+    float tEpsilon = (tEnd - tStart) / (4.0f * (width + height));
+    for (int iteration = 0; iteration < maxIterations && t < tEnd; iteration++)
+    {
+        const cv::Mat& minDepth = keyframe.pyramid.minLevels[level];
+        const cv::Mat& maxDepth = keyframe.pyramid.maxLevels[level];
+        float cellSize = static_cast<float>(1 << level);
+
+        // bias towards the travel direction so points on a cell border land in the next cell
+        glm::vec3 p = o + t * d;
+        float u = fx * p.x / p.z + cx + stepX * 1e-3f;
+        float v = fy * p.y / p.z + cy + stepY * 1e-3f;
+        int cellX = std::clamp(static_cast<int>(std::floor(u / cellSize)), 0, minDepth.cols - 1);
+        int cellY = std::clamp(static_cast<int>(std::floor(v / cellSize)), 0, minDepth.rows - 1);
+
+        // parameter where the ray leaves the cell through the next x or y border
+        float tExit = tEnd;
+        bool borderFound = false;
+        if (stepX != 0.0f)
+        {
+            float border = (stepX > 0.0f ? cellX + 1 : cellX) * cellSize;
+            float b = fx * d.x + (cx - border) * d.z;
+            float tBorder = b != 0.0f ? -(fx * o.x + (cx - border) * o.z) / b : tEnd;
+            if (tBorder > t)
+            {
+                tExit = std::min(tExit, tBorder);
+                borderFound = true;
+            }
+        }
+        if (stepY != 0.0f)
+        {
+            float border = (stepY > 0.0f ? cellY + 1 : cellY) * cellSize;
+            float b = fy * d.y + (cy - border) * d.z;
+            float tBorder = b != 0.0f ? -(fy * o.y + (cy - border) * o.z) / b : tEnd;
+            if (tBorder > t)
+            {
+                tExit = std::min(tExit, tBorder);
+                borderFound = true;
+            }
+        }
+
+        // rounding can put both borders behind t, step a little instead of skipping the rest of the ray
+        if (!borderFound && (stepX != 0.0f || stepY != 0.0f))
+            tExit = std::min(tEnd, t + tEpsilon);
+
+        float rayEnterDepth = p.z;
+        float rayExitDepth = o.z + tExit * d.z;
+        float rayMin = std::min(rayEnterDepth, rayExitDepth);
+        float rayMax = std::max(rayEnterDepth, rayExitDepth);
+        float surfaceMin = minDepth.at<float>(cellY, cellX);
+        float surfaceMax = maxDepth.at<float>(cellY, cellX);
+
+        if (rayMax < surfaceMin || rayMin > surfaceMax + thickness)
+        {
+            t = tExit;
+            level = std::min(level + 1, maxLevel);
+            continue;
+        }
+
+        if (level > 0)
+        {
+            level--;
+            continue;
+        }
+
+        // the ray crosses the surface of this pixel
+        float tHit = d.z != 0.0f ? (surfaceMin - o.z) / d.z : t;
+        tHit = std::clamp(tHit, t, tExit);
+        glm::vec3 cameraHit = o + tHit * d;
+        worldHit = glm::transpose(keyframeRotation) * (cameraHit - keyframeTranslation);
+        return true;
+    }
+
+    return false;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include <glm/glm.hpp>
+
+// min/max mip pyramid over a metric depth map, level 0 is full resolution
+struct DepthPyramid
+{
+    std::vector<cv::Mat> minLevels;
+    std::vector<cv::Mat> maxLevels;
+};
+
+// depth of a tracked frame together with the pose it was captured from, the scale is fitted
+// for every keyframe but the metric pyramid is only built once a hit test needs it
+struct DepthKeyframe
+{
+    cv::Mat depthMap;
+    cv::Size frameSize;
+    float scale = 0.0f;
+    float offset = 0.0f;
+    bool fitted = false;
+    cv::Mat rotationVec;
+    cv::Mat translationVec;
+    DepthPyramid pyramid;
+};
+
+bool fitDepthScale(const cv::Mat& depthMap, const std::vector<cv::Point2f>& imagePoints, const std::vector<cv::Point3f>& objectPoints, const cv::Mat& rotationVec, const cv::Mat& translationVec, float& scale, float& offset);
+cv::Mat toMetricDepth(const cv::Mat& depthMap, float scale, float offset);
+void buildDepthPyramid(const cv::Mat& metricDepth, DepthPyramid& pyramid);
+
+// cheap, keeps a reference to the depth map and fits its scale to the chessboard corners
+bool fitDepthKeyframe(const cv::Mat& depthMap, const cv::Size& frameSize, const std::vector<cv::Point2f>& imagePoints, const std::vector<cv::Point3f>& objectPoints, const cv::Mat& rotationVec, const cv::Mat& translationVec, DepthKeyframe& keyframe);
+// builds the metric pyramid at frame resolution on first use, later calls return right away
+bool buildKeyframePyramid(DepthKeyframe& keyframe);
+
+// intersects the ray through pixel (seen from the given pose) with the keyframe depth, returns the hit in world coordinates
+bool hitTestDepth(const DepthKeyframe& keyframe, const cv::Mat& cameraIntrinsics, const cv::Mat& rotationVec, const cv::Mat& translationVec, const cv::Point2f& pixel, glm::vec3& worldHit, float thickness = 1.0f);
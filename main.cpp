@@ -1,11 +1,14 @@
 #include <iostream>
 #include <vector>
+#include <algorithm>
+#include <limits>
 #include <opencv2/opencv.hpp>
 
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 #include "gpu_transforms.h"
 #include "tracking.h"
+#include "mesh.h"
 
 #include "imgui.h"
 #include "imgui_impl_glfw.h"
@@ -88,6 +91,8 @@ int main()
     int frameTrackingInterval = 0;
     std::string processingTime = "Not tracked";
     std::string reprojectionError = "Not tracked";
+    std::string lastPlacement = "None";
+    TrackingPipeline trackingPipeline;
 
     screenWidth = processedFrames[0].cols;
     screenHeight = processedFrames[0].rows;
@@ -111,6 +116,16 @@ int main()
     glEnable(GL_DEPTH_TEST);
     glDepthFunc(GL_LESS);
 
+    // -- Setup Objects --
+    std::vector<Mesh> meshes;
+    meshes.push_back(createCubeMesh());
+    addMeshInstance(meshes.back(), glm::vec3(0.0f));
+
+    char meshPath[256] = "";
+    int instanceGrid[2] = {1, 1};
+    float instanceSpacing = 1.0f;
+    float instanceScale = 1.0f;
+
     float vertices[] = {
         -1.0f, 1.0f, 0.0f, 1.0f,
         -1.0f, -1.0f, 0.0f, 0.0f,
@@ -203,7 +218,7 @@ int main()
         ImGui::InputInt("Frame Tracking Interval", &frameTrackingInterval);
         if (ImGui::Button("Process Video"))
         {
-            trackCamera(unprocessedFrames, processedFrames, window, processingTime, reprojectionError, frameTrackingInterval);
+            trackCamera(unprocessedFrames, processedFrames, window, meshes, trackingPipeline, processingTime, reprojectionError, frameTrackingInterval);
 
             currentFrameIndex = 0;
             if (!processedFrames.empty() && !processedFrames[0].empty())
@@ -213,9 +228,119 @@ int main()
                 glfwSetWindowSize(window, screenWidth, screenHeight);
             }
         }
+
+        // OBJECT CONTROLS
+        ImGui::InputText("Mesh Path (OBJ/PLY)", meshPath, sizeof(meshPath));
+        ImGui::InputInt2("Instance Grid", instanceGrid);
+        ImGui::InputFloat("Instance Spacing", &instanceSpacing);
+        ImGui::InputFloat("Instance Scale", &instanceScale);
+        if (ImGui::Button("Place Objects"))
+        {
+            // each file is loaded and uploaded once, placing it again only adds instances
+            auto existing = std::find_if(meshes.begin(), meshes.end(), [&meshPath](const Mesh &mesh) { return mesh.path == meshPath; });
+            bool loaded = existing != meshes.end();
+            if (loaded)
+            {
+                // clicks place the last placed mesh, so move it to the back
+                std::rotate(existing, existing + 1, meshes.end());
+            }
+            else
+            {
+                // an empty path places cubes
+                Mesh mesh;
+                loaded = meshPath[0] == '\0';
+                if (loaded)
+                    mesh = createCubeMesh();
+                else
+                    loaded = loadMesh(meshPath, mesh);
+                if (loaded)
+                    meshes.push_back(mesh);
+            }
+
+            if (loaded)
+            {
+                for (int x = 0; x < instanceGrid[0]; x++)
+                    for (int y = 0; y < instanceGrid[1]; y++)
+                        addMeshInstance(meshes.back(), glm::vec3(x * instanceSpacing, y * instanceSpacing, 0.0f), instanceScale);
+            }
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Clear Objects"))
+        {
+            for (Mesh &mesh : meshes)
+                destroyMesh(mesh);
+            meshes.clear();
+        }
+        size_t instanceCount = 0;
+        for (const Mesh &mesh : meshes)
+            instanceCount += mesh.instances.size();
+        ImGui::Text("Objects: %zu meshes, %zu instances", meshes.size(), instanceCount);
+
+        // click on the video to anchor an instance of the last placed mesh where the ray hits the depth
+        if (ImGui::IsMouseClicked(ImGuiMouseButton_Left) && !io.WantCaptureMouse && !meshes.empty())
+        {
+            double cursorX, cursorY;
+            int windowWidth, windowHeight;
+            glfwGetCursorPos(window, &cursorX, &cursorY);
+            glfwGetWindowSize(window, &windowWidth, &windowHeight);
+            cv::Point2f pixel(cursorX * unprocessedFrames[0].cols / windowWidth, cursorY * unprocessedFrames[0].rows / windowHeight);
+
+            // processed frames start at the first frame the chessboard was found in
+            glm::vec3 anchor;
+            auto hitTestStartTime = std::chrono::high_resolution_clock::now();
+            bool hit = placeAnchor(trackingPipeline.result, trackingPipeline.result.firstFrame + currentFrameIndex, pixel, anchor);
+            double hitTestMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - hitTestStartTime).count();
+
+            if (hit)
+            {
+                addMeshInstance(meshes.back(), anchor, instanceScale);
+                lastPlacement = "(" + std::to_string(anchor.x) + ", " + std::to_string(anchor.y) + ", " + std::to_string(anchor.z) + ") in " + std::to_string(hitTestMs) + " ms";
+
+                // only the render stage depends on the objects, so this is cheap
+                trackCamera(unprocessedFrames, processedFrames, window, meshes, trackingPipeline, processingTime, reprojectionError, frameTrackingInterval);
+            }
+            else
+            {
+                lastPlacement = "No hit (process video first)";
+            }
+        }
+        ImGui::Text("Last Placement: %s", lastPlacement.c_str());
+
         ImGui::Text("Processing Time: %s", processingTime.c_str());
         ImGui::Text("Reprojection Error: %s", reprojectionError.c_str());
 
+        ReprojectionStats &reprojectionStats = trackingPipeline.reprojectionStats;
+        if (!reprojectionStats.rmsErrors.empty())
+        {
+            // one point per processed frame so the x axis matches the frame slider,
+            // frames without a detection are pinned to the top of the plot
+            auto plotError = [](void *data, int index)
+            {
+                float error = static_cast<const ReprojectionStats *>(data)->frameErrors[index];
+                return error < 0.0f ? std::numeric_limits<float>::max() : error;
+            };
+            ImGui::PlotLines("RMS Error per Frame (top = not detected)", plotError, &reprojectionStats,
+                             static_cast<int>(reprojectionStats.frameErrors.size()), 0, nullptr, 0.0f, static_cast<float>(reprojectionStats.max) * 1.1f, ImVec2(0, 80));
+            ImGui::Text("Max Corner Error: %.3f px", reprojectionStats.maxCornerError);
+
+            // jump to one of the worst frames
+            ImGui::Text("Worst Frames:");
+            for (int frameIndex : reprojectionStats.worstFrames)
+            {
+                ImGui::SameLine();
+                if (ImGui::SmallButton(std::to_string(frameIndex).c_str()) && !processedFrames.empty())
+                {
+                    currentFrameIndex = std::max(0, std::min(frameIndex - trackingPipeline.result.firstFrame, static_cast<int>(processedFrames.size()) - 1));
+                }
+            }
+
+            if (ImGui::Button("Export Errors CSV"))
+            {
+                std::string filename = imageSavePath + "reprojection_" + std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now().time_since_epoch()).count()) + ".csv";
+                exportReprojectionCSV(reprojectionStats, filename);
+            }
+        }
+
         // Save image button
         if (ImGui::Button("Save Image"))
         {
@@ -253,6 +378,9 @@ int main()
             }
         }
     }
+    for (Mesh &mesh : meshes)
+        destroyMesh(mesh);
+    cleanupPipeline(trackingPipeline);
     cleanupShaderPrograms();
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
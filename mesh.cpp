@@ -0,0 +1,580 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <cstdint>
+#include <cctype>
+#include <limits>
+#include <cstdlib>
+#include <cstring>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include "mesh.h"
+
+static std::string fileExtension(const std::string& path)
+{
+    size_t dot = path.find_last_of('.');
+    if (dot == std::string::npos)
+        return "";
+    std::string extension = path.substr(dot + 1);
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    return extension;
+}
+
+bool loadMeshData(const std::string& path, MeshData& data)
+{
+    std::string extension = fileExtension(path);
+    if (extension == "obj")
+        return loadOBJ(path, data);
+    if (extension == "ply")
+        return loadPLY(path, data);
+
+    std::cerr << "Error: Unsupported mesh format: " << path << std::endl;
+    return false;
+}
+
+bool loadOBJ(const std::string& path, MeshData& data)
+{
+    std::ifstream file(path);
+    if (!file.is_open())
+    {
+        std::cerr << "Error: Could not open mesh file: " << path << std::endl;
+        return false;
+    }
+
+    data.vertices.clear();
+    data.indices.clear();
+
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> normals;
+    // map (position, normal) index pairs to a single vertex so shared corners are indexed only once
+    std::unordered_map<uint64_t, unsigned int> vertexCache;
+    std::vector<unsigned int> face;
+    bool missingNormals = false;
+
+    std::string line;
+    while (std::getline(file, line))
+    {
+        std::istringstream stream(line);
+        std::string type;
+        stream >> type;
+
+        if (type == "v")
+        {
+            glm::vec3 position;
+            stream >> position.x >> position.y >> position.z;
+            positions.push_back(position);
+        }
+        else if (type == "vn")
+        {
+            glm::vec3 normal;
+            stream >> normal.x >> normal.y >> normal.z;
+            normals.push_back(normal);
+        }
+        else if (type == "f")
+        {
+            face.clear();
+            std::string corner;
+            while (stream >> corner)
+            {
+                // corner formats: v, v/vt, v//vn, v/vt/vn
+                size_t firstSlash = corner.find('/');
+                long positionIndex = std::atol(corner.substr(0, firstSlash).c_str());
+                long normalIndex = 0;
+                if (firstSlash != std::string::npos)
+                {
+                    size_t secondSlash = corner.find('/', firstSlash + 1);
+                    if (secondSlash != std::string::npos)
+                        normalIndex = std::atol(corner.substr(secondSlash + 1).c_str());
+                }
+
+                // negative indices are relative to the end of the current list
+                if (positionIndex < 0)
+                    positionIndex += static_cast<long>(positions.size()) + 1;
+                if (normalIndex < 0)
+                    normalIndex += static_cast<long>(normals.size()) + 1;
+
+                if (positionIndex < 1 || positionIndex > static_cast<long>(positions.size()))
+                {
+                    std::cerr << "Error: Invalid face index in mesh file: " << path << std::endl;
+                    return false;
+                }
+                if (normalIndex < 1 || normalIndex > static_cast<long>(normals.size()))
+                {
+                    normalIndex = 0;
+                    missingNormals = true;
+                }
+
+                uint64_t key = (static_cast<uint64_t>(positionIndex) << 32) | static_cast<uint32_t>(normalIndex);
+                auto cached = vertexCache.find(key);
+                if (cached != vertexCache.end())
+                {
+                    face.push_back(cached->second);
+                    continue;
+                }
+
+                const glm::vec3& position = positions[positionIndex - 1];
+                glm::vec3 normal = normalIndex > 0 ? normals[normalIndex - 1] : glm::vec3(0.0f);
+                unsigned int vertexIndex = static_cast<unsigned int>(data.vertices.size() / 6);
+                data.vertices.insert(data.vertices.end(), {position.x, position.y, position.z, normal.x, normal.y, normal.z});
+                vertexCache.emplace(key, vertexIndex);
+                face.push_back(vertexIndex);
+            }
+
+            // triangulate polygons as a fan
+            for (size_t i = 1; i + 1 < face.size(); i++)
+            {
+                data.indices.push_back(face[0]);
+                data.indices.push_back(face[i]);
+                data.indices.push_back(face[i + 1]);
+            }
+        }
+    }
+
+    if (missingNormals)
+        computeNormals(data);
+
+    return !data.indices.empty();
+}
+
+struct PlyProperty
+{
+    std::string name;
+    std::string type;
+    std::string countType;
+    bool isList = false;
+};
+
+struct PlyElement
+{
+    std::string name;
+    size_t count = 0;
+    std::vector<PlyProperty> properties;
+};
+
+static size_t plyTypeSize(const std::string& type)
+{
+    if (type == "char" || type == "uchar" || type == "int8" || type == "uint8")
+        return 1;
+    if (type == "short" || type == "ushort" || type == "int16" || type == "uint16")
+        return 2;
+    if (type == "int" || type == "uint" || type == "float" || type == "int32" || type == "uint32" || type == "float32")
+        return 4;
+    if (type == "double" || type == "float64")
+        return 8;
+    return 0;
+}
+
+static bool readPlyValue(std::istream& stream, const std::string& type, bool binary, bool bigEndian, double& value)
+{
+    if (!binary)
+    {
+        stream >> value;
+        return !stream.fail();
+    }
+
+    size_t size = plyTypeSize(type);
+    unsigned char bytes[8];
+    if (size == 0 || !stream.read(reinterpret_cast<char*>(bytes), size))
+        return false;
+
+    // assumes a little endian host
+    if (bigEndian)
+        std::reverse(bytes, bytes + size);
+
+    if (type == "char" || type == "int8") { int8_t v; std::memcpy(&v, bytes, 1); value = v; }
+    else if (type == "uchar" || type == "uint8") { uint8_t v; std::memcpy(&v, bytes, 1); value = v; }
+    else if (type == "short" || type == "int16") { int16_t v; std::memcpy(&v, bytes, 2); value = v; }
+    else if (type == "ushort" || type == "uint16") { uint16_t v; std::memcpy(&v, bytes, 2); value = v; }
+    else if (type == "int" || type == "int32") { int32_t v; std::memcpy(&v, bytes, 4); value = v; }
+    else if (type == "uint" || type == "uint32") { uint32_t v; std::memcpy(&v, bytes, 4); value = v; }
+    else if (type == "float" || type == "float32") { float v; std::memcpy(&v, bytes, 4); value = v; }
+    else { double v; std::memcpy(&v, bytes, 8); value = v; }
+
+    return true;
+}
+
+bool loadPLY(const std::string& path, MeshData& data)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open())
+    {
+        std::cerr << "Error: Could not open mesh file: " << path << std::endl;
+        return false;
+    }
+
+    data.vertices.clear();
+    data.indices.clear();
+
+    // parse header
+    std::vector<PlyElement> elements;
+    std::string format;
+    std::string line;
+    bool headerComplete = false;
+    while (std::getline(file, line))
+    {
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+
+        std::istringstream stream(line);
+        std::string keyword;
+        stream >> keyword;
+
+        if (keyword == "format")
+        {
+            stream >> format;
+        }
+        else if (keyword == "element")
+        {
+            PlyElement element;
+            stream >> element.name >> element.count;
+            elements.push_back(element);
+        }
+        else if (keyword == "property" && !elements.empty())
+        {
+            PlyProperty property;
+            stream >> property.type;
+            if (property.type == "list")
+            {
+                property.isList = true;
+                stream >> property.countType >> property.type;
+            }
+            stream >> property.name;
+            elements.back().properties.push_back(property);
+        }
+        else if (keyword == "end_header")
+        {
+            headerComplete = true;
+            break;
+        }
+    }
+
+    if (!headerComplete || (format != "ascii" && format != "binary_little_endian" && format != "binary_big_endian"))
+    {
+        std::cerr << "Error: Unsupported PLY header in mesh file: " << path << std::endl;
+        return false;
+    }
+    bool binary = format != "ascii";
+    bool bigEndian = format == "binary_big_endian";
+
+    // every value takes at least one byte, so no count can exceed the rest of the file;
+    // this keeps a corrupt header from reserving or looping over billions of entries
+    std::streampos bodyStart = file.tellg();
+    file.seekg(0, std::ios::end);
+    size_t bodySize = static_cast<size_t>(file.tellg() - bodyStart);
+    file.seekg(bodyStart);
+    for (const PlyElement& element : elements)
+    {
+        if (element.count > bodySize)
+        {
+            std::cerr << "Error: Invalid element count in mesh file: " << path << std::endl;
+            return false;
+        }
+    }
+
+    // parse body
+    size_t vertexCount = 0;
+    bool hasNormals = false;
+    std::vector<unsigned int> face;
+    for (const PlyElement& element : elements)
+    {
+        bool isVertex = element.name == "vertex";
+        bool isFace = element.name == "face";
+        if (isVertex)
+        {
+            vertexCount = element.count;
+            data.vertices.reserve(vertexCount * 6);
+            for (const PlyProperty& property : element.properties)
+                hasNormals |= property.name == "nx";
+        }
+
+        for (size_t i = 0; i < element.count; i++)
+        {
+            float vertex[6] = {0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+            for (const PlyProperty& property : element.properties)
+            {
+                double value;
+                if (!property.isList)
+                {
+                    if (!readPlyValue(file, property.type, binary, bigEndian, value))
+                    {
+                        std::cerr << "Error: Unexpected end of PLY data in mesh file: " << path << std::endl;
+                        return false;
+                    }
+                    if (isVertex)
+                    {
+                        if (property.name == "x") vertex[0] = static_cast<float>(value);
+                        else if (property.name == "y") vertex[1] = static_cast<float>(value);
+                        else if (property.name == "z") vertex[2] = static_cast<float>(value);
+                        else if (property.name == "nx") vertex[3] = static_cast<float>(value);
+                        else if (property.name == "ny") vertex[4] = static_cast<float>(value);
+                        else if (property.name == "nz") vertex[5] = static_cast<float>(value);
+                    }
+                    continue;
+                }
+
+                double count;
+                if (!readPlyValue(file, property.countType, binary, bigEndian, count))
+                {
+                    std::cerr << "Error: Unexpected end of PLY data in mesh file: " << path << std::endl;
+                    return false;
+                }
+                if (!(count >= 0.0 && count <= static_cast<double>(bodySize)))
+                {
+                    std::cerr << "Error: Invalid list count in mesh file: " << path << std::endl;
+                    return false;
+                }
+                face.clear();
+                for (size_t j = 0; j < static_cast<size_t>(count); j++)
+                {
+                    if (!readPlyValue(file, property.type, binary, bigEndian, value))
+                    {
+                        std::cerr << "Error: Unexpected end of PLY data in mesh file: " << path << std::endl;
+                        return false;
+                    }
+                    face.push_back(static_cast<unsigned int>(value));
+                }
+
+                if (isFace && (property.name == "vertex_indices" || property.name == "vertex_index"))
+                {
+                    // triangulate polygons as a fan
+                    for (size_t j = 1; j + 1 < face.size(); j++)
+                    {
+                        data.indices.push_back(face[0]);
+                        data.indices.push_back(face[j]);
+                        data.indices.push_back(face[j + 1]);
+                    }
+                }
+            }
+
+            if (isVertex)
+                data.vertices.insert(data.vertices.end(), vertex, vertex + 6);
+        }
+    }
+
+    for (unsigned int index : data.indices)
+    {
+        if (index >= vertexCount)
+        {
+            std::cerr << "Error: Invalid face index in mesh file: " << path << std::endl;
+            return false;
+        }
+    }
+
+    if (!hasNormals)
+        computeNormals(data);
+
+    return !data.indices.empty();
+}
+
+void computeNormals(MeshData& data)
+{
+    size_t vertexCount = data.vertices.size() / 6;
+    std::vector<glm::vec3> normals(vertexCount, glm::vec3(0.0f));
+
+    // accumulate area weighted face normals
+    for (size_t i = 0; i + 2 < data.indices.size(); i += 3)
+    {
+        unsigned int a = data.indices[i], b = data.indices[i + 1], c = data.indices[i + 2];
+        glm::vec3 pa(data.vertices[a * 6], data.vertices[a * 6 + 1], data.vertices[a * 6 + 2]);
+        glm::vec3 pb(data.vertices[b * 6], data.vertices[b * 6 + 1], data.vertices[b * 6 + 2]);
+        glm::vec3 pc(data.vertices[c * 6], data.vertices[c * 6 + 1], data.vertices[c * 6 + 2]);
+        glm::vec3 faceNormal = glm::cross(pb - pa, pc - pa);
+        normals[a] += faceNormal;
+        normals[b] += faceNormal;
+        normals[c] += faceNormal;
+    }
+
+    for (size_t i = 0; i < vertexCount; i++)
+    {
+        float length = glm::length(normals[i]);
+        glm::vec3 normal = length > 0.0f ? normals[i] / length : glm::vec3(0.0f, 0.0f, 1.0f);
+        data.vertices[i * 6 + 3] = normal.x;
+        data.vertices[i * 6 + 4] = normal.y;
+        data.vertices[i * 6 + 5] = normal.z;
+    }
+}
+
+void uploadMesh(const MeshData& data, Mesh& mesh)
+{
+    // bounding sphere around the axis aligned bounding box
+    glm::vec3 minBounds(std::numeric_limits<float>::max());
+    glm::vec3 maxBounds(-std::numeric_limits<float>::max());
+    for (size_t i = 0; i + 5 < data.vertices.size(); i += 6)
+    {
+        glm::vec3 position(data.vertices[i], data.vertices[i + 1], data.vertices[i + 2]);
+        minBounds = glm::min(minBounds, position);
+        maxBounds = glm::max(maxBounds, position);
+    }
+    mesh.boundsCenter = (minBounds + maxBounds) * 0.5f;
+    mesh.boundsRadius = 0.0f;
+    for (size_t i = 0; i + 5 < data.vertices.size(); i += 6)
+    {
+        glm::vec3 position(data.vertices[i], data.vertices[i + 1], data.vertices[i + 2]);
+        mesh.boundsRadius = std::max(mesh.boundsRadius, glm::length(position - mesh.boundsCenter));
+    }
+
+    static unsigned int nextMeshId = 1;
+    mesh.id = nextMeshId++;
+
+    glGenVertexArrays(1, &mesh.VAO);
+    glGenBuffers(1, &mesh.VBO);
+    glGenBuffers(1, &mesh.EBO);
+    glGenBuffers(1, &mesh.instanceVBO);
+    glBindVertexArray(mesh.VAO);
+
+    glBindBuffer(GL_ARRAY_BUFFER, mesh.VBO);
+    glBufferData(GL_ARRAY_BUFFER, data.vertices.size() * sizeof(float), data.vertices.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, data.indices.size() * sizeof(unsigned int), data.indices.data(), GL_STATIC_DRAW);
+    mesh.indexCount = static_cast<unsigned int>(data.indices.size());
+
+    // position attribute
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void *)0);
+    glEnableVertexAttribArray(0);
+    // normal attribute
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void *)(3 * sizeof(float)));
+    glEnableVertexAttribArray(1);
+
+    // per instance model matrix, one column per attribute location
+    glBindBuffer(GL_ARRAY_BUFFER, mesh.instanceVBO);
+    for (int column = 0; column < 4; column++)
+    {
+        glVertexAttribPointer(2 + column, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void *)(column * sizeof(glm::vec4)));
+        glEnableVertexAttribArray(2 + column);
+        glVertexAttribDivisor(2 + column, 1);
+    }
+    mesh.instanceCapacity = 0;
+
+    glBindVertexArray(0);
+}
+
+bool loadMesh(const std::string& path, Mesh& mesh)
+{
+    MeshData data;
+    if (!loadMeshData(path, data))
+    {
+        std::cerr << "Error: Could not load mesh: " << path << std::endl;
+        return false;
+    }
+
+    uploadMesh(data, mesh);
+    mesh.name = path.substr(path.find_last_of("/\\") + 1);
+    mesh.path = path;
+    std::cout << "Loaded mesh " << mesh.name << " with " << data.vertices.size() / 6 << " vertices and " << data.indices.size() / 3 << " triangles." << std::endl;
+    return true;
+}
+
+Mesh createCubeMesh()
+{
+    MeshData data;
+
+    // 4 vertices per face so that each face gets a flat normal
+    for (int axis = 0; axis < 3; axis++)
+    {
+        for (float side : {-1.0f, 1.0f})
+        {
+            glm::vec3 normal(0.0f);
+            normal[axis] = side;
+            glm::vec3 u(0.0f), v(0.0f);
+            u[(axis + 1) % 3] = 1.0f;
+            v[(axis + 2) % 3] = 1.0f;
+
+            unsigned int baseIndex = static_cast<unsigned int>(data.vertices.size() / 6);
+            for (glm::vec2 corner : {glm::vec2(-1, -1), glm::vec2(1, -1), glm::vec2(1, 1), glm::vec2(-1, 1)})
+            {
+                glm::vec3 position = normal + corner.x * u + corner.y * v;
+                data.vertices.insert(data.vertices.end(), {position.x, position.y, position.z, normal.x, normal.y, normal.z});
+            }
+
+            data.indices.insert(data.indices.end(), {baseIndex, baseIndex + 1, baseIndex + 2, baseIndex, baseIndex + 2, baseIndex + 3});
+        }
+    }
+
+    Mesh mesh;
+    mesh.name = "cube";
+    uploadMesh(data, mesh);
+    return mesh;
+}
+
+void destroyMesh(Mesh& mesh)
+{
+    glDeleteVertexArrays(1, &mesh.VAO);
+    glDeleteBuffers(1, &mesh.VBO);
+    glDeleteBuffers(1, &mesh.EBO);
+    glDeleteBuffers(1, &mesh.instanceVBO);
+    mesh.VAO = mesh.VBO = mesh.EBO = mesh.instanceVBO = 0;
+    mesh.indexCount = 0;
+    mesh.instanceCapacity = 0;
+}
+
+void addMeshInstance(Mesh& mesh, const glm::vec3& position, float scale)
+{
+    glm::mat4 model = glm::translate(glm::mat4(1.0f), position);
+    model = glm::scale(model, glm::vec3(scale));
+    mesh.instances.push_back(model);
+}
+
+static void extractFrustumPlanes(const glm::mat4& viewProjection, glm::vec4 planes[6])
+{
+    // rows of the column major matrix
+    glm::vec4 rows[4];
+    for (int r = 0; r < 4; r++)
+        rows[r] = glm::vec4(viewProjection[0][r], viewProjection[1][r], viewProjection[2][r], viewProjection[3][r]);
+
+    planes[0] = rows[3] + rows[0]; // left
+    planes[1] = rows[3] - rows[0]; // right
+    planes[2] = rows[3] + rows[1]; // bottom
+    planes[3] = rows[3] - rows[1]; // top
+    planes[4] = rows[3] + rows[2]; // near
+    planes[5] = rows[3] - rows[2]; // far
+
+    for (int i = 0; i < 6; i++)
+        planes[i] /= glm::length(glm::vec3(planes[i]));
+}
+
+int drawMeshInstanced(Mesh& mesh, const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix)
+{
+    if (mesh.indexCount == 0 || mesh.instances.empty())
+        return 0;
+
+    glm::vec4 planes[6];
+    extractFrustumPlanes(projectionMatrix * viewMatrix, planes);
+
+    // cull instances whose bounding sphere lies completely outside the frustum
+    mesh.visibleInstances.clear();
+    for (const glm::mat4& model : mesh.instances)
+    {
+        glm::vec3 center = glm::vec3(model * glm::vec4(mesh.boundsCenter, 1.0f));
+        float scale = std::max({glm::length(glm::vec3(model[0])), glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))});
+        float radius = mesh.boundsRadius * scale;
+
+        bool visible = true;
+        for (int i = 0; i < 6 && visible; i++)
+            visible = glm::dot(glm::vec3(planes[i]), center) + planes[i].w >= -radius;
+
+        if (visible)
+            mesh.visibleInstances.push_back(model);
+    }
+
+    if (mesh.visibleInstances.empty())
+        return 0;
+
+    // grow the instance buffer only when needed, otherwise update it in place
+    glBindBuffer(GL_ARRAY_BUFFER, mesh.instanceVBO);
+    if (mesh.visibleInstances.size() > mesh.instanceCapacity)
+    {
+        mesh.instanceCapacity = mesh.instances.size();
+        glBufferData(GL_ARRAY_BUFFER, mesh.instanceCapacity * sizeof(glm::mat4), nullptr, GL_DYNAMIC_DRAW);
+    }
+    glBufferSubData(GL_ARRAY_BUFFER, 0, mesh.visibleInstances.size() * sizeof(glm::mat4), mesh.visibleInstances.data());
+
+    glBindVertexArray(mesh.VAO);
+    glDrawElementsInstanced(GL_TRIANGLES, mesh.indexCount, GL_UNSIGNED_INT, (void *)0, static_cast<GLsizei>(mesh.visibleInstances.size()));
+
+    return static_cast<int>(mesh.visibleInstances.size());
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+// CPU-side mesh data, interleaved as position (3) + normal (3) per vertex
+struct MeshData
+{
+    std::vector<float> vertices;
+    std::vector<unsigned int> indices;
+};
+
+// GPU-side mesh, uploaded once and drawn with one instanced call per frame
+struct Mesh
+{
+    std::string name;
+    // file the mesh was loaded from, empty for generated meshes
+    std::string path;
+    // unique per upload, unlike GL names which the driver reuses after deletion
+    unsigned int id = 0;
+    unsigned int VAO = 0;
+    unsigned int VBO = 0;
+    unsigned int EBO = 0;
+    unsigned int instanceVBO = 0;
+    unsigned int indexCount = 0;
+    size_t instanceCapacity = 0;
+
+    // bounding sphere in model space, used for frustum culling
+    glm::vec3 boundsCenter = glm::vec3(0.0f);
+    float boundsRadius = 0.0f;
+
+    // model matrices of all placed instances
+    std::vector<glm::mat4> instances;
+    // scratch buffer for the instances surviving culling, reused between frames
+    std::vector<glm::mat4> visibleInstances;
+};
+
+bool loadMeshData(const std::string& path, MeshData& data);
+bool loadOBJ(const std::string& path, MeshData& data);
+bool loadPLY(const std::string& path, MeshData& data);
+void computeNormals(MeshData& data);
+
+bool loadMesh(const std::string& path, Mesh& mesh);
+Mesh createCubeMesh();
+void uploadMesh(const MeshData& data, Mesh& mesh);
+void destroyMesh(Mesh& mesh);
+
+void addMeshInstance(Mesh& mesh, const glm::vec3& position, float scale = 1.0f);
+
+// expects objectShaderProgram to be bound with view and projection already set
+int drawMeshInstanced(Mesh& mesh, const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix);
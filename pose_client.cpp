@@ -0,0 +1,156 @@
+#include <iostream>
+#include <string>
+#include <atomic>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "pose_client.h"
+
+bool writeExact(int socket, const void *data, size_t size)
+{
+    const char *bytes = static_cast<const char *>(data);
+    while (size > 0)
+    {
+        ssize_t written = send(socket, bytes, size, MSG_NOSIGNAL);
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written <= 0)
+            return false;
+        bytes += written;
+        size -= written;
+    }
+    return true;
+}
+
+bool readExact(int socket, void *data, size_t size)
+{
+    char *bytes = static_cast<char *>(data);
+    while (size > 0)
+    {
+        ssize_t received = recv(socket, bytes, size, 0);
+        if (received < 0 && errno == EINTR)
+            continue;
+        if (received <= 0)
+            return false;
+        bytes += received;
+        size -= received;
+    }
+    return true;
+}
+
+// creates an anonymous shared memory object, its name is unlinked right away so only the fd keeps it alive
+static int createSharedMemory(size_t size)
+{
+    static std::atomic<int> counter(0);
+    std::string name = "/ar-placement-" + std::to_string(getpid()) + "-" + std::to_string(counter++);
+    int memoryFd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (memoryFd < 0)
+        return -1;
+    shm_unlink(name.c_str());
+
+    if (ftruncate(memoryFd, size) != 0)
+    {
+        close(memoryFd);
+        return -1;
+    }
+    return memoryFd;
+}
+
+bool connectPoseClient(PoseClient &client, const std::string &socketPath, const PoseHello &hello)
+{
+    disconnectPoseClient(client);
+
+    client.socket = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (client.socket < 0)
+    {
+        std::cerr << "Error: Could not create socket: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    std::strncpy(address.sun_path, socketPath.c_str(), sizeof(address.sun_path) - 1);
+    if (connect(client.socket, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0)
+    {
+        std::cerr << "Error: Could not connect to pose service at " << socketPath << ": " << std::strerror(errno) << std::endl;
+        disconnectPoseClient(client);
+        return false;
+    }
+
+    // shared frame ring
+    client.slotCount = hello.slotCount;
+    client.slotSize = hello.slotSize;
+    client.ringSize = static_cast<size_t>(hello.slotCount) * hello.slotSize;
+    int memoryFd = createSharedMemory(client.ringSize);
+    if (memoryFd < 0)
+    {
+        std::cerr << "Error: Could not create shared memory: " << std::strerror(errno) << std::endl;
+        disconnectPoseClient(client);
+        return false;
+    }
+    void *ring = mmap(nullptr, client.ringSize, PROT_READ | PROT_WRITE, MAP_SHARED, memoryFd, 0);
+    if (ring == MAP_FAILED)
+    {
+        std::cerr << "Error: Could not map shared memory: " << std::strerror(errno) << std::endl;
+        close(memoryFd);
+        disconnectPoseClient(client);
+        return false;
+    }
+    client.ring = static_cast<unsigned char *>(ring);
+
+    // send the hello with the ring's fd attached
+    PoseHello message = hello;
+    iovec payload{&message, sizeof(message)};
+    char control[CMSG_SPACE(sizeof(int))] = {};
+    msghdr header{};
+    header.msg_iov = &payload;
+    header.msg_iovlen = 1;
+    header.msg_control = control;
+    header.msg_controllen = sizeof(control);
+    cmsghdr *descriptor = CMSG_FIRSTHDR(&header);
+    descriptor->cmsg_level = SOL_SOCKET;
+    descriptor->cmsg_type = SCM_RIGHTS;
+    descriptor->cmsg_len = CMSG_LEN(sizeof(int));
+    std::memcpy(CMSG_DATA(descriptor), &memoryFd, sizeof(int));
+
+    bool sent = sendmsg(client.socket, &header, MSG_NOSIGNAL) == static_cast<ssize_t>(sizeof(message));
+    close(memoryFd);
+    if (!sent)
+    {
+        std::cerr << "Error: Could not send hello to pose service." << std::endl;
+        disconnectPoseClient(client);
+        return false;
+    }
+
+    return true;
+}
+
+void disconnectPoseClient(PoseClient &client)
+{
+    if (client.ring)
+        munmap(client.ring, client.ringSize);
+    if (client.socket >= 0)
+        close(client.socket);
+    client = PoseClient();
+}
+
+unsigned char *poseClientSlot(PoseClient &client, uint32_t slot)
+{
+    if (!client.ring || slot >= client.slotCount)
+        return nullptr;
+    return client.ring + static_cast<size_t>(slot) * client.slotSize;
+}
+
+bool sendFrame(PoseClient &client, const PoseFrameRequest &request)
+{
+    return client.socket >= 0 && writeExact(client.socket, &request, sizeof(request));
+}
+
+bool receivePose(PoseClient &client, PoseReply &reply)
+{
+    return client.socket >= 0 && readExact(client.socket, &reply, sizeof(reply)) && reply.type == PoseMessageReply;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "pose_protocol.h"
+
+// client side of pose_service, deliberately free of OpenCV and GL so other processes can link it
+struct PoseClient
+{
+    int socket = -1;
+    unsigned char *ring = nullptr;
+    size_t ringSize = 0;
+    uint32_t slotCount = 0;
+    uint64_t slotSize = 0;
+};
+
+bool connectPoseClient(PoseClient &client, const std::string &socketPath, const PoseHello &hello);
+void disconnectPoseClient(PoseClient &client);
+
+// frame pixels are written straight into a slot of the shared ring, the slot may be reused
+// once the reply for the request that used it has been received
+unsigned char *poseClientSlot(PoseClient &client, uint32_t slot);
+bool sendFrame(PoseClient &client, const PoseFrameRequest &request);
+bool receivePose(PoseClient &client, PoseReply &reply);
+
+// blocking helpers for the fixed size messages, shared with the service
+bool writeExact(int socket, const void *data, size_t size);
+bool readExact(int socket, void *data, size_t size);
@@ -0,0 +1,186 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <opencv2/opencv.hpp>
+#include "calibration.h"
+#include "pose_protocol.h"
+#include "pose_client.h"
+
+// OpenCV is only used here to decode the video, the client itself doesn't need it
+
+struct ClientStats
+{
+    std::vector<double> latencies;
+    // Ok replies only, so calibration warm-up and frames without a board don't dominate the tail
+    std::vector<double> okLatencies;
+    int replies[4] = {0, 0, 0, 0};
+    bool failed = false;
+};
+
+static std::vector<cv::Mat> readVideo(const std::string &filename)
+{
+    cv::VideoCapture cap(filename);
+    if (!cap.isOpened())
+    {
+        std::cerr << "Error: Could not open video file: " << filename << std::endl;
+        return {};
+    }
+
+    std::vector<cv::Mat> frames;
+    cv::Mat frame;
+    while (cap.read(frame))
+        frames.push_back(frame.clone());
+    return frames;
+}
+
+static void runClient(int clientIndex, const std::string &socketPath, const std::vector<cv::Mat> &frames, int frameCount, int depth, bool verbose, ClientStats &stats)
+{
+    PoseClient client;
+    PoseHello hello;
+    hello.slotCount = depth;
+    hello.slotSize = frames[0].total() * frames[0].elemSize();
+    if (!connectPoseClient(client, socketPath, hello))
+    {
+        stats.failed = true;
+        return;
+    }
+
+    std::vector<std::chrono::steady_clock::time_point> sendTimes(frameCount);
+    uint64_t nextRequest = 0;
+    auto submit = [&](uint32_t slot)
+    {
+        // a real client would decode or render straight into the slot
+        const cv::Mat &frame = frames[nextRequest % frames.size()];
+        std::memcpy(poseClientSlot(client, slot), frame.data, frame.total() * frame.elemSize());
+
+        PoseFrameRequest request;
+        request.slot = slot;
+        request.requestId = nextRequest;
+        request.width = frame.cols;
+        request.height = frame.rows;
+        request.stride = frame.cols * frame.channels();
+        request.channels = frame.channels();
+        sendTimes[nextRequest++] = std::chrono::steady_clock::now();
+        return sendFrame(client, request);
+    };
+
+    // fill every slot, then send the next frame as soon as a reply frees one
+    for (int slot = 0; slot < depth && nextRequest < static_cast<uint64_t>(frameCount); slot++)
+    {
+        if (!submit(slot))
+            stats.failed = true;
+    }
+
+    int received = 0;
+    while (!stats.failed && received < frameCount)
+    {
+        PoseReply reply;
+        if (!receivePose(client, reply) || reply.requestId >= sendTimes.size())
+        {
+            stats.failed = true;
+            break;
+        }
+
+        double latency = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - sendTimes[reply.requestId]).count();
+        stats.latencies.push_back(latency);
+        if (reply.status == PoseStatusOk)
+            stats.okLatencies.push_back(latency);
+        if (reply.status >= 0 && reply.status < 4)
+            stats.replies[reply.status]++;
+        received++;
+
+        if (verbose)
+        {
+            std::cout << "Client " << clientIndex << " frame " << reply.requestId << ": status " << reply.status
+                      << ", t = (" << reply.translation[0] << ", " << reply.translation[1] << ", " << reply.translation[2] << ")"
+                      << ", f = (" << reply.fx << ", " << reply.fy << ")"
+                      << ", error " << reply.reprojectionError << ", " << latency << " ms" << std::endl;
+        }
+
+        if (nextRequest < static_cast<uint64_t>(frameCount) && !submit(reply.slot))
+            stats.failed = true;
+    }
+
+    disconnectPoseClient(client);
+}
+
+int main(int argc, char **argv)
+{
+    std::string socketPath = defaultPoseSocketPath;
+    std::string videoPath = std::string(__FILE__).substr(0, std::string(__FILE__).find_last_of("/\\") + 1) + "videos/tracker3.mp4";
+    int clientCount = 4;
+    int depth = 4;
+    int frameCount = 0;
+    bool verbose = false;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string argument = argv[i];
+        if (argument == "--socket" && i + 1 < argc)
+            socketPath = argv[++i];
+        else if (argument == "--video" && i + 1 < argc)
+            videoPath = argv[++i];
+        else if (argument == "--clients" && i + 1 < argc)
+            clientCount = std::max(1, std::atoi(argv[++i]));
+        else if (argument == "--depth" && i + 1 < argc)
+            depth = std::max(1, std::atoi(argv[++i]));
+        else if (argument == "--frames" && i + 1 < argc)
+            frameCount = std::max(1, std::atoi(argv[++i]));
+        else if (argument == "--verbose")
+            verbose = true;
+        else
+        {
+            std::cerr << "Usage: " << argv[0] << " [--socket path] [--video path] [--clients count] [--depth frames in flight] [--frames per client] [--verbose]" << std::endl;
+            return -1;
+        }
+    }
+
+    std::vector<cv::Mat> frames = readVideo(videoPath);
+    if (frames.empty())
+        return -1;
+    if (frameCount == 0)
+        frameCount = static_cast<int>(frames.size());
+
+    std::cout << "Sending " << frameCount << " frames from " << clientCount << " clients with " << depth << " frames in flight each." << std::endl;
+
+    std::vector<ClientStats> stats(clientCount);
+    std::vector<std::thread> clients;
+    auto startTime = std::chrono::steady_clock::now();
+    for (int i = 0; i < clientCount; i++)
+        clients.emplace_back(runClient, i, std::cref(socketPath), std::cref(frames), frameCount, depth, verbose, std::ref(stats[i]));
+    for (std::thread &client : clients)
+        client.join();
+    double elapsedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
+    std::vector<double> latencies, okLatencies;
+    int replies[4] = {0, 0, 0, 0};
+    int failedClients = 0;
+    for (const ClientStats &clientStats : stats)
+    {
+        latencies.insert(latencies.end(), clientStats.latencies.begin(), clientStats.latencies.end());
+        okLatencies.insert(okLatencies.end(), clientStats.okLatencies.begin(), clientStats.okLatencies.end());
+        for (int status = 0; status < 4; status++)
+            replies[status] += clientStats.replies[status];
+        failedClients += clientStats.failed ? 1 : 0;
+    }
+    std::sort(latencies.begin(), latencies.end());
+    std::sort(okLatencies.begin(), okLatencies.end());
+
+    std::cout << "Replies: " << latencies.size() << " in " << elapsedSeconds << " s (" << latencies.size() / elapsedSeconds << " frames/s)" << std::endl;
+    std::cout << "Status: " << replies[PoseStatusOk] << " ok, " << replies[PoseStatusNotFound] << " not found, "
+              << replies[PoseStatusCalibrating] << " calibrating, " << replies[PoseStatusInvalid] << " invalid" << std::endl;
+    std::cout << "Latency (ok): p50 " << percentile(okLatencies, 0.5) << " ms, p95 " << percentile(okLatencies, 0.95) << " ms, p99 "
+              << percentile(okLatencies, 0.99) << " ms, max " << (okLatencies.empty() ? 0.0 : okLatencies.back()) << " ms" << std::endl;
+    std::cout << "Latency (all): p50 " << percentile(latencies, 0.5) << " ms, p95 " << percentile(latencies, 0.95) << " ms, p99 "
+              << percentile(latencies, 0.99) << " ms, max " << (latencies.empty() ? 0.0 : latencies.back()) << " ms" << std::endl;
+    if (failedClients > 0)
+        std::cerr << "Error: " << failedClients << " clients lost their connection." << std::endl;
+
+    return failedClients > 0 ? -1 : 0;
+}
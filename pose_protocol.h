@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+
+// wire format between pose_service and its clients, both ends run on the same machine
+// so the structs are sent as is. Pixels never go over the socket: the client passes a
+// shared memory ring with the hello message and frame requests only name a slot in it.
+
+const char *const defaultPoseSocketPath = "/tmp/ar-placement-pose.sock";
+
+enum PoseMessageType : uint32_t
+{
+    PoseMessageHello = 1,
+    PoseMessageFrame = 2,
+    PoseMessageReply = 3
+};
+
+enum PoseStatus : int32_t
+{
+    PoseStatusOk = 0,
+    PoseStatusNotFound = 1,     // chessboard not detected in the frame
+    PoseStatusCalibrating = 2,  // not enough views collected for calibration yet
+    PoseStatusInvalid = 3       // request does not fit the shared memory ring
+};
+
+// sent once per connection, the ring's file descriptor is attached as SCM_RIGHTS
+struct PoseHello
+{
+    uint32_t type = PoseMessageHello;
+    uint32_t slotCount = 0;
+    uint64_t slotSize = 0;
+    int32_t patternWidth = 9;
+    int32_t patternHeight = 6;
+    // views used for calibration, taken at least frameInterval requests apart
+    int32_t calibrationFrames = 15;
+    int32_t frameInterval = 10;
+};
+
+struct PoseFrameRequest
+{
+    uint32_t type = PoseMessageFrame;
+    uint32_t slot = 0;
+    uint64_t requestId = 0;
+    int32_t width = 0;
+    int32_t height = 0;
+    int32_t stride = 0;
+    int32_t channels = 3;  // 3 = BGR, 1 = greyscale
+};
+
+// replies can arrive out of order when several requests are in flight, match them by requestId
+struct PoseReply
+{
+    uint32_t type = PoseMessageReply;
+    int32_t status = PoseStatusOk;
+    uint64_t requestId = 0;
+    uint32_t slot = 0;
+    double rotation[3] = {0, 0, 0};     // Rodrigues vector, board to camera
+    double translation[3] = {0, 0, 0};
+    double fx = 0, fy = 0, cx = 0, cy = 0;
+    double reprojectionError = 0;     // RMS over the chessboard corners, in pixels
+};
@@ -0,0 +1,421 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <csignal>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <opencv2/opencv.hpp>
+#include "calibration.h"
+#include "pose_protocol.h"
+#include "pose_client.h"
+
+// one connected client, kept alive until its last queued frame has been answered
+struct PoseSession
+{
+    int socket = -1;
+    unsigned char *ring = nullptr;
+    size_t ringSize = 0;
+    PoseHello hello;
+    std::vector<cv::Point3f> objectPoints;
+
+    // replies from different workers must not interleave on the socket
+    std::mutex writeMutex;
+
+    // queued and unanswered requests, at most hello.slotCount so one client can't flood the shared queue
+    std::mutex flightMutex;
+    std::condition_variable flightAvailable;
+    uint32_t inFlight = 0;
+
+    // calibration from the client's own frames, collected like trackCamera does with frameInterval
+    std::mutex calibrationMutex;
+    std::vector<std::vector<cv::Point2f>> views;
+    uint64_t lastViewRequestId = 0;
+    // set while one worker runs calibrateCamera outside the lock
+    bool calibrating = false;
+    cv::Mat cameraIntrinsics, cameraDistortion;
+
+    ~PoseSession()
+    {
+        if (ring)
+            munmap(ring, ringSize);
+        if (socket >= 0)
+            close(socket);
+    }
+};
+
+struct PoseJob
+{
+    std::shared_ptr<PoseSession> session;
+    PoseFrameRequest request;
+};
+
+// frames of all clients share one queue, so the worker pool stays busy no matter who sends
+struct JobQueue
+{
+    std::mutex mutex;
+    std::condition_variable available;
+    std::deque<PoseJob> jobs;
+    bool closed = false;
+};
+
+static void pushJob(JobQueue &queue, PoseJob job)
+{
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.closed)
+            return;
+        queue.jobs.push_back(std::move(job));
+    }
+    queue.available.notify_one();
+}
+
+// returns false once the queue is closed and drained
+static bool popJob(JobQueue &queue, PoseJob &job)
+{
+    std::unique_lock<std::mutex> lock(queue.mutex);
+    queue.available.wait(lock, [&queue] { return !queue.jobs.empty() || queue.closed; });
+    if (queue.jobs.empty())
+        return false;
+    job = std::move(queue.jobs.front());
+    queue.jobs.pop_front();
+    return true;
+}
+
+static void closeQueue(JobQueue &queue)
+{
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.closed = true;
+    }
+    queue.available.notify_all();
+}
+
+static bool receiveHello(PoseSession &session)
+{
+    iovec payload{&session.hello, sizeof(session.hello)};
+    char control[CMSG_SPACE(sizeof(int))] = {};
+    msghdr header{};
+    header.msg_iov = &payload;
+    header.msg_iovlen = 1;
+    header.msg_control = control;
+    header.msg_controllen = sizeof(control);
+
+    if (recvmsg(session.socket, &header, MSG_WAITALL) != static_cast<ssize_t>(sizeof(session.hello)))
+        return false;
+
+    cmsghdr *descriptor = CMSG_FIRSTHDR(&header);
+    if (!descriptor || descriptor->cmsg_level != SOL_SOCKET || descriptor->cmsg_type != SCM_RIGHTS)
+        return false;
+
+    int memoryFd;
+    std::memcpy(&memoryFd, CMSG_DATA(descriptor), sizeof(int));
+
+    // the hello comes from the client, a bad pattern would throw in createBoardPoints and a ring
+    // larger than the shared memory would crash a worker with SIGBUS on the first read past its end
+    const PoseHello &hello = session.hello;
+    struct stat memoryInfo;
+    bool valid = hello.type == PoseMessageHello && hello.slotCount > 0 && hello.slotSize > 0 &&
+                 hello.patternWidth >= 2 && hello.patternWidth <= 64 && hello.patternHeight >= 2 && hello.patternHeight <= 64 &&
+                 hello.calibrationFrames >= 1 && hello.frameInterval >= 0 &&
+                 fstat(memoryFd, &memoryInfo) == 0 && memoryInfo.st_size > 0 &&
+                 hello.slotSize <= static_cast<uint64_t>(memoryInfo.st_size) / hello.slotCount;
+    if (!valid)
+    {
+        close(memoryFd);
+        return false;
+    }
+
+    session.ringSize = static_cast<size_t>(hello.slotCount) * hello.slotSize;
+    void *ring = mmap(nullptr, session.ringSize, PROT_READ, MAP_SHARED, memoryFd, 0);
+    close(memoryFd);
+    if (ring == MAP_FAILED)
+        return false;
+
+    session.ring = static_cast<unsigned char *>(ring);
+    session.objectPoints = createBoardPoints(hello.patternWidth, hello.patternHeight);
+    return true;
+}
+
+static PoseReply processFrame(PoseSession &session, const PoseFrameRequest &request)
+{
+    PoseReply reply;
+    reply.requestId = request.requestId;
+    reply.slot = request.slot;
+
+    const PoseHello &hello = session.hello;
+    if (request.slot >= hello.slotCount || request.width <= 0 || request.height <= 0 || (request.channels != 1 && request.channels != 3) ||
+        request.stride < request.width * request.channels || static_cast<uint64_t>(request.stride) * request.height > hello.slotSize)
+    {
+        reply.status = PoseStatusInvalid;
+        return reply;
+    }
+
+    // wrap the slot without copying the pixels
+    unsigned char *pixels = session.ring + static_cast<size_t>(request.slot) * hello.slotSize;
+    cv::Mat frame(request.height, request.width, request.channels == 3 ? CV_8UC3 : CV_8UC1, pixels, request.stride);
+
+    std::vector<cv::Point2f> corners;
+    if (!detectChessboard(frame, cv::Size(hello.patternWidth, hello.patternHeight), corners))
+    {
+        reply.status = PoseStatusNotFound;
+        return reply;
+    }
+
+    cv::Mat cameraIntrinsics, cameraDistortion;
+    std::vector<std::vector<cv::Point2f>> calibrationViews;
+    {
+        std::lock_guard<std::mutex> lock(session.calibrationMutex);
+        if (session.cameraIntrinsics.empty())
+        {
+            // another worker is already calibrating, don't block the pool waiting for it
+            if (session.calibrating)
+            {
+                reply.status = PoseStatusCalibrating;
+                return reply;
+            }
+
+            if (session.views.empty() || request.requestId >= session.lastViewRequestId + hello.frameInterval)
+            {
+                session.views.push_back(corners);
+                session.lastViewRequestId = request.requestId;
+            }
+
+            if (static_cast<int>(session.views.size()) < hello.calibrationFrames)
+            {
+                reply.status = PoseStatusCalibrating;
+                return reply;
+            }
+
+            session.calibrating = true;
+            calibrationViews = session.views;
+        }
+        else
+        {
+            cameraIntrinsics = session.cameraIntrinsics;
+            cameraDistortion = session.cameraDistortion;
+        }
+    }
+
+    // calibrate without holding the lock, frames of this client arriving meanwhile reply right away
+    if (!calibrationViews.empty())
+    {
+        std::vector<std::vector<cv::Point3f>> combinedObjectPoints(calibrationViews.size(), session.objectPoints);
+        cv::Mat rotations, translations;
+        try
+        {
+            cv::calibrateCamera(combinedObjectPoints, calibrationViews, frame.size(), cameraIntrinsics, cameraDistortion, rotations, translations);
+        }
+        catch (...)
+        {
+            // let the next frame try again
+            std::lock_guard<std::mutex> lock(session.calibrationMutex);
+            session.calibrating = false;
+            throw;
+        }
+
+        std::lock_guard<std::mutex> lock(session.calibrationMutex);
+        session.cameraIntrinsics = cameraIntrinsics;
+        session.cameraDistortion = cameraDistortion;
+        session.calibrating = false;
+        std::cout << "Calibrated client " << session.socket << " with " << calibrationViews.size() << " views." << std::endl;
+    }
+
+    // once calibrated, every frame only needs a pose against the known intrinsics
+    cv::Mat rotationVec, translationVec;
+    cv::solvePnP(session.objectPoints, corners, cameraIntrinsics, cameraDistortion, rotationVec, translationVec);
+
+    for (int i = 0; i < 3; i++)
+    {
+        reply.rotation[i] = rotationVec.at<double>(i);
+        reply.translation[i] = translationVec.at<double>(i);
+    }
+    reply.fx = cameraIntrinsics.at<double>(0, 0);
+    reply.fy = cameraIntrinsics.at<double>(1, 1);
+    reply.cx = cameraIntrinsics.at<double>(0, 2);
+    reply.cy = cameraIntrinsics.at<double>(1, 2);
+    // same RMS metric the GUI reports per frame
+    double maxError;
+    computeCornerErrors(session.objectPoints, corners, rotationVec, translationVec, cameraIntrinsics, cameraDistortion, reply.reprojectionError, maxError);
+    return reply;
+}
+
+static void runWorker(JobQueue &queue)
+{
+    PoseJob job;
+    while (popJob(queue, job))
+    {
+        PoseReply reply;
+        try
+        {
+            reply = processFrame(*job.session, job.request);
+        }
+        catch (const cv::Exception &e)
+        {
+            std::cerr << "OpenCV exception: " << e.what() << std::endl;
+            reply.requestId = job.request.requestId;
+            reply.slot = job.request.slot;
+            reply.status = PoseStatusInvalid;
+        }
+        catch (const std::exception &e)
+        {
+            // a single bad request must not take down the service for every client
+            std::cerr << "Exception: " << e.what() << std::endl;
+            reply.requestId = job.request.requestId;
+            reply.slot = job.request.slot;
+            reply.status = PoseStatusInvalid;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(job.session->writeMutex);
+            writeExact(job.session->socket, &reply, sizeof(reply));
+        }
+        {
+            std::lock_guard<std::mutex> lock(job.session->flightMutex);
+            job.session->inFlight--;
+        }
+        job.session->flightAvailable.notify_one();
+        // don't keep the session alive until the next job, its socket closes after the last reply
+        job.session.reset();
+    }
+}
+
+// sockets of the connection threads, so the service can stop them before the queue goes away
+struct ConnectionList
+{
+    std::mutex mutex;
+    std::condition_variable finished;
+    std::vector<int> sockets;
+};
+
+static void addConnection(ConnectionList &connections, int socket)
+{
+    std::lock_guard<std::mutex> lock(connections.mutex);
+    connections.sockets.push_back(socket);
+}
+
+static void removeConnection(ConnectionList &connections, int socket)
+{
+    std::lock_guard<std::mutex> lock(connections.mutex);
+    connections.sockets.erase(std::find(connections.sockets.begin(), connections.sockets.end(), socket));
+    connections.finished.notify_all();
+}
+
+// shuts down every client socket so the reads fail, then waits until no connection thread uses the queue
+static void stopConnections(ConnectionList &connections)
+{
+    std::unique_lock<std::mutex> lock(connections.mutex);
+    for (int socket : connections.sockets)
+        shutdown(socket, SHUT_RDWR);
+    connections.finished.wait(lock, [&connections] { return connections.sockets.empty(); });
+}
+
+// reads requests of one client and queues them, so a client can keep several frames in flight
+static void serveConnection(int socket, JobQueue &queue, ConnectionList &connections)
+{
+    // the session owns the socket, it must outlive the entry in the connection list
+    auto session = std::make_shared<PoseSession>();
+    session->socket = socket;
+    if (receiveHello(*session))
+    {
+        std::cout << "Client " << socket << " connected with " << session->hello.slotCount << " frame slots." << std::endl;
+
+        PoseFrameRequest request;
+        while (readExact(socket, &request, sizeof(request)) && request.type == PoseMessageFrame)
+        {
+            // a client with all its slots in flight has to wait for a reply, stop reading until then
+            {
+                std::unique_lock<std::mutex> lock(session->flightMutex);
+                session->flightAvailable.wait(lock, [&session] { return session->inFlight < session->hello.slotCount; });
+                session->inFlight++;
+            }
+            pushJob(queue, {session, request});
+        }
+
+        std::cout << "Client " << socket << " disconnected." << std::endl;
+    }
+    else
+    {
+        std::cerr << "Error: Invalid hello from client " << socket << std::endl;
+    }
+
+    removeConnection(connections, socket);
+}
+
+int main(int argc, char **argv)
+{
+    std::string socketPath = defaultPoseSocketPath;
+    int workerCount = std::max(1u, std::thread::hardware_concurrency());
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string argument = argv[i];
+        if (argument == "--socket" && i + 1 < argc)
+            socketPath = argv[++i];
+        else if (argument == "--workers" && i + 1 < argc)
+            workerCount = std::max(1, std::atoi(argv[++i]));
+        else
+        {
+            std::cerr << "Usage: " << argv[0] << " [--socket path] [--workers count]" << std::endl;
+            return -1;
+        }
+    }
+
+    // frames are processed in parallel by the pool, so keep OpenCV from spawning threads of its own
+    cv::setNumThreads(1);
+    std::signal(SIGPIPE, SIG_IGN);
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    std::strncpy(address.sun_path, socketPath.c_str(), sizeof(address.sun_path) - 1);
+    unlink(socketPath.c_str());
+    if (listener < 0 || bind(listener, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 || listen(listener, SOMAXCONN) != 0)
+    {
+        std::cerr << "Error: Could not listen on " << socketPath << ": " << std::strerror(errno) << std::endl;
+        return -1;
+    }
+
+    JobQueue queue;
+    ConnectionList connections;
+    std::vector<std::thread> workers;
+    for (int i = 0; i < workerCount; i++)
+        workers.emplace_back(runWorker, std::ref(queue));
+
+    std::cout << "Pose service listening on " << socketPath << " with " << workerCount << " workers." << std::endl;
+    while (true)
+    {
+        int client = accept(listener, nullptr, nullptr);
+        if (client < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            std::cerr << "Error: Could not accept client: " << std::strerror(errno) << std::endl;
+            break;
+        }
+        addConnection(connections, client);
+        std::thread(serveConnection, client, std::ref(queue), std::ref(connections)).detach();
+    }
+
+    // no connection may push jobs once the queue is closed, then let the workers answer what is
+    // queued and stop them before their threads are destroyed
+    stopConnections(connections);
+    closeQueue(queue);
+    for (std::thread &worker : workers)
+        worker.join();
+
+    close(listener);
+    unlink(socketPath.c_str());
+    return -1;
+}
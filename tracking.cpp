@@ -5,69 +5,97 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <chrono>
+#include <functional>
+#include <fstream>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
 #include "gpu_transforms.h"
+#include "mesh.h"
+#include "hit_testing.h"
+#include "calibration.h"
+#include "tracking.h"
 
 using namespace cv;
 
 int patternWidth = 9;
 int patternHeight = 6;
 
-void trackCamera(const std::vector<cv::Mat> &inputFrames, std::vector<cv::Mat> &outputFrames, GLFWwindow* window, std::string &processingTime, std::string &reprojectionError, int frameInterval = 0)
+static size_t hashCombine(size_t seed, size_t value)
 {
-    std::chrono::milliseconds totalProcessingTime(0);
-    auto trackingStartTime = std::chrono::high_resolution_clock::now();
+    return seed ^ (value + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2));
+}
 
-    outputFrames.clear();
-    glfwMakeContextCurrent(window);
+static size_t hashIndices(size_t seed, const std::vector<int> &values)
+{
+    seed = hashCombine(seed, values.size());
+    for (int value : values)
+        seed = hashCombine(seed, std::hash<int>()(value));
+    return seed;
+}
 
-    // Setup cube
-    float cubeVertices[] = {
-        -1.0f, -1.0f, -1.0f, // triangle 1 : begin
-        -1.0f, -1.0f, 1.0f,
-        -1.0f, 1.0f, 1.0f, // triangle 1 : end
-        1.0f, 1.0f, -1.0f, // triangle 2 : begin
-        -1.0f, -1.0f, -1.0f,
-        -1.0f, 1.0f, -1.0f, // triangle 2 : end
-        1.0f, -1.0f, 1.0f,
-        -1.0f, -1.0f, -1.0f,
-        1.0f, -1.0f, -1.0f,
-        1.0f, 1.0f, -1.0f,
-        1.0f, -1.0f, -1.0f,
-        -1.0f, -1.0f, -1.0f,
-        -1.0f, -1.0f, -1.0f,
-        -1.0f, 1.0f, 1.0f,
-        -1.0f, 1.0f, -1.0f,
-        1.0f, -1.0f, 1.0f,
-        -1.0f, -1.0f, 1.0f,
-        -1.0f, -1.0f, -1.0f,
-        -1.0f, 1.0f, 1.0f,
-        -1.0f, -1.0f, 1.0f,
-        1.0f, -1.0f, 1.0f,
-        1.0f, 1.0f, 1.0f,
-        1.0f, -1.0f, -1.0f,
-        1.0f, 1.0f, -1.0f,
-        1.0f, -1.0f, -1.0f,
-        1.0f, 1.0f, 1.0f,
-        1.0f, -1.0f, 1.0f,
-        1.0f, 1.0f, 1.0f,
-        1.0f, 1.0f, -1.0f,
-        -1.0f, 1.0f, -1.0f,
-        1.0f, 1.0f, 1.0f,
-        -1.0f, 1.0f, -1.0f,
-        -1.0f, 1.0f, 1.0f,
-        1.0f, 1.0f, 1.0f,
-        -1.0f, 1.0f, 1.0f,
-        1.0f, -1.0f, 1.0f};
-
-    unsigned int cubeVAO, cubeVBO;
-    glGenVertexArrays(1, &cubeVAO);
-    glGenBuffers(1, &cubeVBO);
-    glBindVertexArray(cubeVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(cubeVertices), cubeVertices, GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void *)0);
-    glEnableVertexAttribArray(0);
+static size_t hashScene(const std::vector<Mesh> &meshes)
+{
+    size_t seed = meshes.size();
+    for (const Mesh &mesh : meshes)
+    {
+        seed = hashCombine(seed, mesh.id);
+        seed = hashCombine(seed, mesh.instances.size());
+        for (const glm::mat4 &model : mesh.instances)
+        {
+            const float *values = glm::value_ptr(model);
+            for (int i = 0; i < 16; i++)
+                seed = hashCombine(seed, std::hash<float>()(values[i]));
+        }
+    }
+    return seed;
+}
+
+// returns true if the stage has to run for the given input key, its outputs are invalid until completeStage
+static bool stageNeedsRun(StageCache &stage, size_t key)
+{
+    if (stage.valid && stage.key == key)
+        return false;
+
+    stage.valid = false;
+    return true;
+}
+
+// records the key only once the stage finished, so a stage that throws is re-run on the next call
+static void completeStage(StageCache &stage, size_t key)
+{
+    stage.key = key;
+    stage.valid = true;
+    stage.revision++;
+}
 
+static const std::vector<cv::Point2f> &detectFrame(TrackingPipeline &pipeline, const std::vector<cv::Mat> &inputFrames, int frameIndex)
+{
+    if (!pipeline.frameDetected[frameIndex])
+    {
+        detectChessboard(inputFrames[frameIndex], cv::Size(patternWidth, patternHeight), pipeline.frameCorners[frameIndex]);
+        pipeline.frameDetected[frameIndex] = 1;
+    }
+    return pipeline.frameCorners[frameIndex];
+}
+
+static void resetPipeline(TrackingPipeline &pipeline, const std::vector<cv::Mat> &inputFrames)
+{
+    // GL objects don't depend on the video, keep them
+    unsigned int screenVAO = pipeline.screenVAO, screenVBO = pipeline.screenVBO, texture = pipeline.texture;
+    pipeline = TrackingPipeline();
+    pipeline.screenVAO = screenVAO;
+    pipeline.screenVBO = screenVBO;
+    pipeline.texture = texture;
+
+    pipeline.inputData = inputFrames.data();
+    pipeline.inputFrameCount = inputFrames.size();
+    pipeline.frameDetected.assign(inputFrames.size(), 0);
+    pipeline.frameCorners.assign(inputFrames.size(), std::vector<cv::Point2f>());
+}
+
+static void setupScreenQuad(TrackingPipeline &pipeline)
+{
     float vertices[] = {
         -1.0f, 1.0f, 0.0f, 1.0f,
         -1.0f, -1.0f, 0.0f, 0.0f,
@@ -77,11 +105,10 @@ void trackCamera(const std::vector<cv::Mat> &inputFrames, std::vector<cv::Mat> &
         1.0f, -1.0f, 1.0f, 0.0f,
         1.0f, 1.0f, 1.0f, 1.0f};
 
-    unsigned int screenVAO, screenVBO;
-    glGenVertexArrays(1, &screenVAO);
-    glGenBuffers(1, &screenVBO);
-    glBindVertexArray(screenVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, screenVBO);
+    glGenVertexArrays(1, &pipeline.screenVAO);
+    glGenBuffers(1, &pipeline.screenVBO);
+    glBindVertexArray(pipeline.screenVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, pipeline.screenVBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices,
                  GL_STATIC_DRAW);
 
@@ -93,9 +120,8 @@ void trackCamera(const std::vector<cv::Mat> &inputFrames, std::vector<cv::Mat> &
     glEnableVertexAttribArray(1);
 
     // Texture Setup
-    unsigned int texture;
-    glGenTextures(1, &texture);
-    glBindTexture(GL_TEXTURE_2D, texture);
+    glGenTextures(1, &pipeline.texture);
+    glBindTexture(GL_TEXTURE_2D, pipeline.texture);
     // set texture parameters
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S,
                     GL_CLAMP_TO_EDGE);
@@ -103,132 +129,157 @@ void trackCamera(const std::vector<cv::Mat> &inputFrames, std::vector<cv::Mat> &
                     GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
 
+// track 2D image points on the frames selected by frameInterval
+static void runDetectStage(TrackingPipeline &pipeline, const std::vector<cv::Mat> &inputFrames, int frameInterval)
+{
+    pipeline.trackedFrameIndices.clear();
+    pipeline.frameToCalibrationIndex.clear();
+    pipeline.adjustedStart = 0;
 
-
-    // construct 3D world points
-    std::vector<cv::Point3f> objectPoints;
-    objectPoints.reserve(patternWidth * patternHeight);
-    for (int y = 0; y < patternHeight; ++y)
-    {
-        for (int x = 0; x < patternWidth; ++x)
-        {
-            objectPoints.emplace_back(static_cast<float>(x), static_cast<float>(y), 0.0f);
-        }
-    }
-
-    std::vector<std::vector<cv::Point3f>> combinedObjectPoints;
-    std::vector<std::vector<cv::Point2f>> combinedImagePoints;
-    std::vector<int> trackedFrameIndices;  // Store which frames were actually tracked
-    std::vector<int> frameToCalibrationIndex;  // Map frame index to actually tracked frame index
-
-
-    // track 2D image points
     int nextTrackingCandidate = 0;
-    int adjustedStart = 0;
     int lastTrackedCalibrationIndex = -1;
-    
-    
+
     for(int currentFrameIndex = 0; currentFrameIndex < inputFrames.size(); currentFrameIndex++)
     {
         if (currentFrameIndex < nextTrackingCandidate)
         {
             // skip this frame for tracking, but map it to the last successful calibration
-            frameToCalibrationIndex.push_back(lastTrackedCalibrationIndex);
+            pipeline.frameToCalibrationIndex.push_back(lastTrackedCalibrationIndex);
             continue;
         }
-        auto frame = inputFrames[currentFrameIndex];
-        cv::Mat greyScale;
-        cv::cvtColor(frame, greyScale, cv::COLOR_BGR2GRAY);
 
-        std::vector<cv::Point2f> imagePoints;
-        cv::findChessboardCorners(greyScale, cv::Size(patternWidth, patternHeight), imagePoints, cv::CALIB_CB_ADAPTIVE_THRESH + cv::CALIB_CB_NORMALIZE_IMAGE);
+        // frames detected by an earlier run (or by the evaluation) come from the cache
+        const std::vector<cv::Point2f> &imagePoints = detectFrame(pipeline, inputFrames, currentFrameIndex);
 
         if (!imagePoints.empty())
         {
             std::cout << "Tracked frame " << currentFrameIndex << " / " << inputFrames.size() << "\r" << std::flush;
             // tracking successful, add new imagePoints and set next tracking candidate
-            combinedImagePoints.push_back(imagePoints);
-            combinedObjectPoints.push_back(objectPoints);
-            trackedFrameIndices.push_back(currentFrameIndex);
-            lastTrackedCalibrationIndex = combinedImagePoints.size() - 1;
-            frameToCalibrationIndex.push_back(lastTrackedCalibrationIndex);
+            pipeline.trackedFrameIndices.push_back(currentFrameIndex);
+            lastTrackedCalibrationIndex = pipeline.trackedFrameIndices.size() - 1;
+            pipeline.frameToCalibrationIndex.push_back(lastTrackedCalibrationIndex);
             nextTrackingCandidate = currentFrameIndex + frameInterval;
         }
         else {
-            if (combinedImagePoints.empty()) {
+            if (pipeline.trackedFrameIndices.empty()) {
                 // no previous successful tracking, skip frame and adjust start to skip untracked beginning frames
-                adjustedStart++;
+                pipeline.adjustedStart++;
                 continue;
             }
 
             // tracking failed, map this frame to the last successful calibration
-            frameToCalibrationIndex.push_back(lastTrackedCalibrationIndex);
+            pipeline.frameToCalibrationIndex.push_back(lastTrackedCalibrationIndex);
         }
     }
+}
+
+static void runCalibrateStage(TrackingPipeline &pipeline, const std::vector<cv::Mat> &inputFrames, const std::vector<cv::Point3f> &objectPoints)
+{
+    std::vector<std::vector<cv::Point3f>> combinedObjectPoints;
+    std::vector<std::vector<cv::Point2f>> combinedImagePoints;
+    for (int frameIndex : pipeline.trackedFrameIndices)
+    {
+        combinedObjectPoints.push_back(objectPoints);
+        combinedImagePoints.push_back(pipeline.frameCorners[frameIndex]);
+    }
 
-    // calibrate
     std::cout << "Calibrating camera with " << combinedImagePoints.size() << " tracked frames." << std::endl;
-    cv::Mat cameraIntrinsics, cameraDistortion, rotations, translations;
-    cv::calibrateCamera(combinedObjectPoints, combinedImagePoints, inputFrames[0].size(), cameraIntrinsics, cameraDistortion, rotations, translations);
+    pipeline.result.cameraIntrinsics = cv::Mat();
+    pipeline.cameraDistortion = cv::Mat();
+    pipeline.rotations = cv::Mat();
+    pipeline.translations = cv::Mat();
+    cv::calibrateCamera(combinedObjectPoints, combinedImagePoints, inputFrames[0].size(), pipeline.result.cameraIntrinsics, pipeline.cameraDistortion, pipeline.rotations, pipeline.translations);
+}
+
+// expand rotations and translations to cover all frames
+static void runPoseStage(TrackingPipeline &pipeline, const std::vector<cv::Mat> &inputFrames)
+{
+    std::cout << "Expanding pose information to all frames." << std::endl;
+    TrackingResult &result = pipeline.result;
+    result.firstFrame = pipeline.adjustedStart;
+    result.frameToKeyframe = pipeline.frameToCalibrationIndex;
+    result.rotations.assign(inputFrames.size() - pipeline.adjustedStart, cv::Mat());
+    result.translations.assign(inputFrames.size() - pipeline.adjustedStart, cv::Mat());
+
+    for (int frameIndex = pipeline.adjustedStart; frameIndex < inputFrames.size(); frameIndex++)
+    {
+        int localIndex = frameIndex - pipeline.adjustedStart;
+        int calibrationIndex = pipeline.frameToCalibrationIndex[localIndex];
+
+        if (calibrationIndex >= 0) {
+            result.rotations[localIndex] = pipeline.rotations.row(calibrationIndex).clone();
+            result.translations[localIndex] = pipeline.translations.row(calibrationIndex).clone();
+        }
+    }
+}
 
-    // depth tracking
-    std::vector<cv::Mat> depths;
+static void runDepthStage(TrackingPipeline &pipeline, const std::vector<cv::Mat> &inputFrames, const std::vector<cv::Point3f> &objectPoints)
+{
+    // depth tracking, the network only runs for keyframes it has not seen before
     std::string trackingPath = std::string(__FILE__).substr(0, std::string(__FILE__).find_last_of("/\\") + 1) + "depth_tracking/";
-    for (size_t i = 0; i < trackedFrameIndices.size(); i++)
+    pipeline.depths.clear();
+    for (size_t i = 0; i < pipeline.trackedFrameIndices.size(); i++)
     {
-        std::cout << "Computing depth for frame pair " << i << " / " << trackedFrameIndices.size() - 1 << "\r" << std::flush;
-        auto frame = inputFrames[trackedFrameIndices[i]].clone();
+        int frameIndex = pipeline.trackedFrameIndices[i];
+        auto cached = pipeline.frameDepths.find(frameIndex);
+        if (cached != pipeline.frameDepths.end())
+        {
+            pipeline.depths.push_back(cached->second);
+            continue;
+        }
 
+        std::cout << "Computing depth for frame pair " << i << " / " << pipeline.trackedFrameIndices.size() - 1 << "\r" << std::flush;
         // save image to tracking folder
         std::string imagePath = trackingPath + "frame.png";
-        cv::imwrite(imagePath, frame);
+        cv::imwrite(imagePath, inputFrames[frameIndex]);
 
         std::string cmd = "python depth_tracking/Depth-Anything-V2/run.py --encoder vits --img-path \"" + trackingPath + "frame.png\" --outdir \"" + trackingPath + "out\" --grayscale --pred-only";
         system(cmd.c_str());
         cv::Mat depthMap = cv::imread(trackingPath + "out/frame.png", cv::IMREAD_GRAYSCALE);
 
-        depths.push_back(depthMap.clone());
+        // cv::Mat is reference counted, the cache, the keyframe list and the keyframes share one map
+        pipeline.frameDepths[frameIndex] = depthMap;
+        pipeline.depths.push_back(depthMap);
     }
 
-    // expand rotations, translations and depths to cover all frames
-    std::cout << "Expanding pose and depth information to all frames." << std::endl;
-    std::vector<cv::Mat> allRotations(inputFrames.size() - adjustedStart);
-    std::vector<cv::Mat> allTranslations(inputFrames.size() - adjustedStart);
-    std::vector<cv::Mat> allDepths(inputFrames.size() - adjustedStart);
-
-    for (int frameIndex = adjustedStart; frameIndex < inputFrames.size(); frameIndex++)
+    // scale depth maps to board units, the pyramids for hit testing are built on the first click per keyframe
+    std::cout << "Fitting depth scale for " << pipeline.depths.size() << " keyframes." << std::endl;
+    TrackingResult &result = pipeline.result;
+    result.keyframes.assign(pipeline.depths.size(), DepthKeyframe());
+    for (size_t i = 0; i < pipeline.depths.size(); i++)
     {
-        int localIndex = frameIndex - adjustedStart;
-        int calibrationIndex = frameToCalibrationIndex[localIndex];
-        
-        if (calibrationIndex >= 0) {
-            allRotations[localIndex] = rotations.row(calibrationIndex).clone();
-            allTranslations[localIndex] = translations.row(calibrationIndex).clone();
-            
-            if (calibrationIndex < depths.size()) {
-                allDepths[localIndex] = depths[calibrationIndex].clone();
-            } else if (calibrationIndex > 0 && !depths.empty()) {
-                // for the last frame, reuse the last available depth map
-                allDepths[localIndex] = depths.back().clone();
-            }
+        if (!fitDepthKeyframe(pipeline.depths[i], inputFrames[0].size(), pipeline.frameCorners[pipeline.trackedFrameIndices[i]], objectPoints, pipeline.rotations.row(i), pipeline.translations.row(i), result.keyframes[i]))
+        {
+            std::cerr << "Error: Could not scale depth of keyframe " << i << std::endl;
         }
     }
+}
 
-    auto trackingEndTime = std::chrono::high_resolution_clock::now();
-    totalProcessingTime += std::chrono::duration_cast<std::chrono::milliseconds>(trackingEndTime - trackingStartTime);
+// draws the objects over every frame, returns the time spent without reading back the pixels
+static std::chrono::milliseconds runRenderStage(TrackingPipeline &pipeline, const std::vector<cv::Mat> &inputFrames, std::vector<Mesh> &meshes)
+{
+    std::chrono::milliseconds renderTime(0);
+    const TrackingResult &result = pipeline.result;
+    pipeline.renderedFrames.clear();
+
+    // the intrinsics are shared by all frames, so the projection only has to be set once
+    glm::mat4 projectionMatrix = getProjectionMatrix(result.cameraIntrinsics);
+    glUseProgram(objectShaderProgram);
+    glUniformMatrix4fv(objectProjectionLocation, 1, GL_FALSE, glm::value_ptr(projectionMatrix));
 
     // undistort images and draw object
-    for (int frameIndex = adjustedStart; frameIndex < inputFrames.size(); frameIndex++)
+    for (int frameIndex = result.firstFrame; frameIndex < inputFrames.size(); frameIndex++)
     {
         std::cout << "Processing frame " << frameIndex << " / " << inputFrames.size() << "\r" << std::flush;
-        
+
         auto frameStartTime = std::chrono::high_resolution_clock::now();
-        
+
         auto frame = inputFrames[frameIndex].clone();
-        int localIndex = frameIndex - adjustedStart;
-        cv::Mat rotationVec = allRotations[localIndex];
-        cv::Mat translationVec = allTranslations[localIndex];
+        int localIndex = frameIndex - result.firstFrame;
+        cv::Mat rotationVec = result.rotations[localIndex];
+        cv::Mat translationVec = result.translations[localIndex];
 
         // cv::undistort(frame, output, cameraIntrinsics, cameraDistortion);
 
@@ -236,81 +287,238 @@ void trackCamera(const std::vector<cv::Mat> &inputFrames, std::vector<cv::Mat> &
 
         cv::flip(frame, frame, 0);
 
-        glBindTexture(GL_TEXTURE_2D, texture);
+        glBindTexture(GL_TEXTURE_2D, pipeline.texture);
         cv::cvtColor(frame, frame, cv::COLOR_BGR2RGB);
         glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, frame.cols, frame.rows,
                      0, GL_RGB, GL_UNSIGNED_BYTE, frame.data);
 
         glDisable(GL_DEPTH_TEST);
-        glBindVertexArray(screenVAO);
-        glBindBuffer(GL_ARRAY_BUFFER, screenVBO);
+        glBindVertexArray(pipeline.screenVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, pipeline.screenVBO);
         glUseProgram(screenShaderProgram);
         glDrawArrays(GL_TRIANGLES, 0, 6);
 
         glEnable(GL_DEPTH_TEST);
         glUseProgram(objectShaderProgram);
-        glBindVertexArray(cubeVAO);
-        glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);
         glm::mat4 viewMatrix = getViewMatrix(rotationVec, translationVec);
-        glm::mat4 projectionMatrix = getProjectionMatrix(cameraIntrinsics);
+        glUniformMatrix4fv(objectViewLocation, 1, GL_FALSE, glm::value_ptr(viewMatrix));
 
-        glUniformMatrix4fv(glGetUniformLocation(objectShaderProgram, "view"), 1, GL_FALSE, glm::value_ptr(viewMatrix));
-        glUniformMatrix4fv(glGetUniformLocation(objectShaderProgram, "projection"), 1, GL_FALSE, glm::value_ptr(projectionMatrix));
-
-        glDrawArrays(GL_TRIANGLES, 0, 36);
+        // one instanced draw call per mesh, instances outside the view are culled
+        for (Mesh &mesh : meshes)
+        {
+            drawMeshInstanced(mesh, viewMatrix, projectionMatrix);
+        }
 
         // exclude reading out pixel values from timing, since this would not be part of real world application
         auto frameEndTime = std::chrono::high_resolution_clock::now();
-        totalProcessingTime += std::chrono::duration_cast<std::chrono::milliseconds>(frameEndTime - frameStartTime);
+        renderTime += std::chrono::duration_cast<std::chrono::milliseconds>(frameEndTime - frameStartTime);
 
-        std::vector<unsigned char> pixels(frame.cols * frame.rows * 3);
-        glReadPixels(0, 0, frame.cols, frame.rows, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
-        cv::Mat output(frame.rows, frame.cols, CV_8UC3, pixels.data());
+        // read straight into the output frame, rows are tightly packed
+        cv::Mat output(frame.rows, frame.cols, CV_8UC3);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, frame.cols, frame.rows, GL_RGB, GL_UNSIGNED_BYTE, output.data);
         cv::flip(output, output, 0);
         cv::cvtColor(output, output, cv::COLOR_RGB2BGR);
 
-        // outputFrames.push_back(output.clone());
-        outputFrames.push_back(allDepths[localIndex].clone());
+        pipeline.renderedFrames.push_back(output);
     }
 
-    processingTime = std::to_string(totalProcessingTime.count()) + " ms";
+    return renderTime;
+}
 
-    // determine reprojection error (for all frames)
-    std::vector<std::vector<cv::Point2f>> allFrameImagePoints(inputFrames.size());
-    for (int frameIndex = 0; frameIndex < inputFrames.size(); frameIndex++)
+// determine reprojection error (for all frames), frames are independent so they are evaluated in parallel
+static void runEvaluateStage(TrackingPipeline &pipeline, const std::vector<cv::Mat> &inputFrames, const std::vector<cv::Point3f> &objectPoints)
+{
+    const TrackingResult &result = pipeline.result;
+    int frameCount = static_cast<int>(inputFrames.size()) - result.firstFrame;
+    std::cout << "Evaluating " << frameCount << " frames." << std::endl;
+
+    // every frame writes only its own slot, also in the detection cache
+    std::vector<float> rmsErrors(frameCount, -1.0f);
+    std::vector<float> maxErrors(frameCount, -1.0f);
+    cv::parallel_for_(cv::Range(0, frameCount), [&](const cv::Range &range)
     {
-        std::cout << "Detecting frame " << frameIndex << " / " << inputFrames.size() << "\r" << std::flush;
-        auto frame = inputFrames[frameIndex];
-        cv::Mat greyScale;
-        cv::cvtColor(frame, greyScale, cv::COLOR_BGR2GRAY);
-
-        std::vector<cv::Point2f> imagePoints;
-        cv::findChessboardCorners(greyScale, cv::Size(patternWidth, patternHeight), imagePoints, 
-                                  cv::CALIB_CB_ADAPTIVE_THRESH + cv::CALIB_CB_NORMALIZE_IMAGE);
-         
-        allFrameImagePoints[frameIndex] = imagePoints;
-    }
+        for (int localIndex = range.start; localIndex < range.end; localIndex++)
+        {
+            const std::vector<cv::Point2f> &imagePoints = detectFrame(pipeline, inputFrames, result.firstFrame + localIndex);
+
+            // Skip frames where chessboard was not detected
+            if (imagePoints.empty() || result.rotations[localIndex].empty())
+                continue;
 
-    double totalError = 0;
-    int validFrameCount = 0;
-    for (int frameIndex = adjustedStart; frameIndex < inputFrames.size(); frameIndex++)
+            double rmsError, maxError;
+            computeCornerErrors(objectPoints, imagePoints, result.rotations[localIndex], result.translations[localIndex],
+                                result.cameraIntrinsics, pipeline.cameraDistortion, rmsError, maxError);
+            rmsErrors[localIndex] = static_cast<float>(rmsError);
+            maxErrors[localIndex] = static_cast<float>(maxError);
+        }
+    });
+
+    ReprojectionStats &stats = pipeline.reprojectionStats;
+    stats = ReprojectionStats();
+    stats.frameErrors = rmsErrors;
+    for (int localIndex = 0; localIndex < frameCount; localIndex++)
     {
-        // Skip frames where chessboard was not detected
-        if (allFrameImagePoints[frameIndex].empty()) {
+        if (rmsErrors[localIndex] < 0.0f)
             continue;
-        }
+        stats.frameIndices.push_back(result.firstFrame + localIndex);
+        stats.rmsErrors.push_back(rmsErrors[localIndex]);
+        stats.maxErrors.push_back(maxErrors[localIndex]);
+        stats.mean += rmsErrors[localIndex];
+        stats.maxCornerError = std::max(stats.maxCornerError, static_cast<double>(maxErrors[localIndex]));
+    }
 
-        int localIndex = frameIndex - adjustedStart;
-        
-        std::vector<cv::Point2f> projectedPoints;
-        cv::projectPoints(objectPoints, allRotations[localIndex], allTranslations[localIndex], 
-                          cameraIntrinsics, cameraDistortion, projectedPoints);
-        
-        totalError += cv::norm(allFrameImagePoints[frameIndex], projectedPoints, cv::NORM_L2) / projectedPoints.size();
-        validFrameCount++;
+    if (stats.rmsErrors.empty()) {
+        pipeline.reprojectionError = "No frames detected";
+        return;
+    }
+
+    stats.mean /= stats.rmsErrors.size();
+    std::vector<float> sortedErrors = stats.rmsErrors;
+    std::sort(sortedErrors.begin(), sortedErrors.end());
+    stats.median = percentile(sortedErrors, 0.5);
+    stats.p95 = percentile(sortedErrors, 0.95);
+    stats.max = sortedErrors.back();
+
+    std::vector<int> order(stats.rmsErrors.size());
+    for (size_t i = 0; i < order.size(); i++)
+        order[i] = static_cast<int>(i);
+    size_t worstCount = std::min<size_t>(5, order.size());
+    std::partial_sort(order.begin(), order.begin() + worstCount, order.end(), [&stats](int a, int b) { return stats.rmsErrors[a] > stats.rmsErrors[b]; });
+    for (size_t i = 0; i < worstCount; i++)
+        stats.worstFrames.push_back(stats.frameIndices[order[i]]);
+
+    char summary[128];
+    std::snprintf(summary, sizeof(summary), "mean %.3f, median %.3f, p95 %.3f, max %.3f px", stats.mean, stats.median, stats.p95, stats.max);
+    pipeline.reprojectionError = summary;
+}
+
+bool exportReprojectionCSV(const ReprojectionStats &stats, const std::string &filename)
+{
+    std::ofstream file(filename);
+    if (!file.is_open())
+    {
+        std::cerr << "Error: Could not write file: " << filename << std::endl;
+        return false;
     }
 
-    if (validFrameCount > 0) {
-        reprojectionError = std::to_string(totalError / validFrameCount);
+    file << "frame,rms_error,max_error" << std::endl;
+    for (size_t i = 0; i < stats.frameIndices.size(); i++)
+        file << stats.frameIndices[i] << "," << stats.rmsErrors[i] << "," << stats.maxErrors[i] << "\n";
+
+    std::cout << "Reprojection errors saved to " << filename << std::endl;
+    return true;
+}
+
+void trackCamera(const std::vector<cv::Mat> &inputFrames, std::vector<cv::Mat> &outputFrames, GLFWwindow* window, std::vector<Mesh> &meshes, TrackingPipeline &pipeline, std::string &processingTime, std::string &reprojectionError, int frameInterval)
+{
+    std::chrono::milliseconds totalProcessingTime(0);
+    std::string stagesRun;
+    auto markStage = [&stagesRun](const char *stage)
+    {
+        stagesRun += (stagesRun.empty() ? "" : ", ") + std::string(stage);
+    };
+
+    glfwMakeContextCurrent(window);
+    if (pipeline.screenVAO == 0)
+        setupScreenQuad(pipeline);
+
+    if (pipeline.inputData != inputFrames.data() || pipeline.inputFrameCount != inputFrames.size())
+        resetPipeline(pipeline, inputFrames);
+
+    // construct 3D world points
+    std::vector<cv::Point3f> objectPoints = createBoardPoints(patternWidth, patternHeight);
+
+    // every stage is keyed by its parameters and the revisions of the stages it reads from,
+    // so a change only re-runs the stages downstream of it
+    auto trackingStartTime = std::chrono::high_resolution_clock::now();
+
+    size_t detectKey = std::hash<int>()(frameInterval);
+    if (stageNeedsRun(pipeline.detectStage, detectKey))
+    {
+        runDetectStage(pipeline, inputFrames, frameInterval);
+        completeStage(pipeline.detectStage, detectKey);
+        markStage("detect");
     }
-}
\ No newline at end of file
+
+    if (pipeline.trackedFrameIndices.empty())
+    {
+        std::cerr << "Error: Chessboard was not detected in any frame." << std::endl;
+        pipeline.detectStage.valid = false;
+        return;
+    }
+
+    // keyed by the selected frames, so an interval that selects the same frames keeps the calibration
+    size_t calibrateKey = hashIndices(0, pipeline.trackedFrameIndices);
+    if (stageNeedsRun(pipeline.calibrateStage, calibrateKey))
+    {
+        runCalibrateStage(pipeline, inputFrames, objectPoints);
+        completeStage(pipeline.calibrateStage, calibrateKey);
+        markStage("calibrate");
+    }
+
+    size_t poseKey = hashIndices(hashCombine(pipeline.calibrateStage.revision, pipeline.adjustedStart), pipeline.frameToCalibrationIndex);
+    if (stageNeedsRun(pipeline.poseStage, poseKey))
+    {
+        runPoseStage(pipeline, inputFrames);
+        completeStage(pipeline.poseStage, poseKey);
+        markStage("pose");
+    }
+
+    size_t depthKey = pipeline.calibrateStage.revision;
+    if (stageNeedsRun(pipeline.depthStage, depthKey))
+    {
+        runDepthStage(pipeline, inputFrames, objectPoints);
+        completeStage(pipeline.depthStage, depthKey);
+        markStage("depth");
+    }
+
+    auto trackingEndTime = std::chrono::high_resolution_clock::now();
+    totalProcessingTime += std::chrono::duration_cast<std::chrono::milliseconds>(trackingEndTime - trackingStartTime);
+
+    size_t renderKey = hashCombine(hashCombine(pipeline.poseStage.revision, pipeline.depthStage.revision), hashScene(meshes));
+    if (stageNeedsRun(pipeline.renderStage, renderKey))
+    {
+        totalProcessingTime += runRenderStage(pipeline, inputFrames, meshes);
+        completeStage(pipeline.renderStage, renderKey);
+        markStage("render");
+    }
+    outputFrames = pipeline.renderedFrames;
+
+    size_t evaluateKey = pipeline.poseStage.revision;
+    if (stageNeedsRun(pipeline.evaluateStage, evaluateKey))
+    {
+        runEvaluateStage(pipeline, inputFrames, objectPoints);
+        completeStage(pipeline.evaluateStage, evaluateKey);
+        markStage("evaluate");
+    }
+    reprojectionError = pipeline.reprojectionError;
+
+    processingTime = std::to_string(totalProcessingTime.count()) + " ms (" + (stagesRun.empty() ? "cached" : stagesRun) + ")";
+}
+
+void cleanupPipeline(TrackingPipeline &pipeline)
+{
+    glDeleteVertexArrays(1, &pipeline.screenVAO);
+    glDeleteBuffers(1, &pipeline.screenVBO);
+    glDeleteTextures(1, &pipeline.texture);
+    pipeline.screenVAO = pipeline.screenVBO = pipeline.texture = 0;
+}
+
+bool placeAnchor(TrackingResult &result, int frameIndex, const cv::Point2f &pixel, glm::vec3 &anchor)
+{
+    int localIndex = frameIndex - result.firstFrame;
+    if (localIndex < 0 || localIndex >= static_cast<int>(result.frameToKeyframe.size()))
+        return false;
+
+    // frames between keyframes reuse the depth of the last keyframe, seen from their own pose
+    int keyframeIndex = result.frameToKeyframe[localIndex];
+    if (keyframeIndex < 0 || keyframeIndex >= static_cast<int>(result.keyframes.size()) || result.rotations[localIndex].empty())
+        return false;
+
+    DepthKeyframe &keyframe = result.keyframes[keyframeIndex];
+    if (!buildKeyframePyramid(keyframe))
+        return false;
+
+    return hitTestDepth(keyframe, result.cameraIntrinsics, result.rotations[localIndex], result.translations[localIndex], pixel, anchor);
+}
@@ -1,5 +1,89 @@
 #pragma once
 
+#include <map>
+#include <string>
 #include <opencv2/opencv.hpp>
+#include "mesh.h"
+#include "hit_testing.h"
 
-void trackCamera(const std::vector<cv::Mat> &inputFrames, std::vector<cv::Mat> &outputFrames, GLFWwindow* window, std::string &processingTime, std::string &reprojectionError, int frameInterval = 0);
+// per frame poses and keyframe depth of the last processed video, used for placing objects
+struct TrackingResult
+{
+    cv::Mat cameraIntrinsics;
+    int firstFrame = 0;
+    std::vector<cv::Mat> rotations;
+    std::vector<cv::Mat> translations;
+    std::vector<int> frameToKeyframe;
+    std::vector<DepthKeyframe> keyframes;
+};
+
+// per frame reprojection error of the detected chessboard corners, in pixels
+struct ReprojectionStats
+{
+    std::vector<int> frameIndices;
+    std::vector<float> rmsErrors;
+    std::vector<float> maxErrors;
+    // RMS error of every frame from firstFrame on, -1 where the board was not detected
+    std::vector<float> frameErrors;
+
+    // distribution of the per frame RMS errors
+    double mean = 0, median = 0, p95 = 0, max = 0;
+    // largest single corner error over all frames
+    double maxCornerError = 0;
+    // frames with the highest RMS error, worst first
+    std::vector<int> worstFrames;
+};
+
+// bookkeeping of one processing stage, it only re-runs when the key of its inputs changes
+struct StageCache
+{
+    size_t key = 0;
+    bool valid = false;
+    int revision = 0;
+};
+
+// cached outputs of the processing stages, kept between calls of trackCamera
+// detect -> calibrate -> pose / depth -> render, pose -> evaluate
+struct TrackingPipeline
+{
+    // input video, all stages are invalidated when it changes
+    const cv::Mat *inputData = nullptr;
+    size_t inputFrameCount = 0;
+
+    // detect: chessboard corners per frame, every frame is detected at most once
+    StageCache detectStage;
+    std::vector<char> frameDetected;
+    std::vector<std::vector<cv::Point2f>> frameCorners;
+    std::vector<int> trackedFrameIndices;
+    std::vector<int> frameToCalibrationIndex;
+    int adjustedStart = 0;
+
+    // calibrate
+    StageCache calibrateStage;
+    cv::Mat cameraDistortion, rotations, translations;
+
+    // pose
+    StageCache poseStage;
+
+    // depth: network output per frame index, so keyframes seen before are not predicted again
+    StageCache depthStage;
+    std::map<int, cv::Mat> frameDepths;
+    std::vector<cv::Mat> depths;
+
+    // render
+    StageCache renderStage;
+    std::vector<cv::Mat> renderedFrames;
+    unsigned int screenVAO = 0, screenVBO = 0, texture = 0;
+
+    // evaluate
+    StageCache evaluateStage;
+    ReprojectionStats reprojectionStats;
+    std::string reprojectionError = "Not tracked";
+
+    TrackingResult result;
+};
+
+void trackCamera(const std::vector<cv::Mat> &inputFrames, std::vector<cv::Mat> &outputFrames, GLFWwindow* window, std::vector<Mesh> &meshes, TrackingPipeline &pipeline, std::string &processingTime, std::string &reprojectionError, int frameInterval = 0);
+void cleanupPipeline(TrackingPipeline &pipeline);
+bool exportReprojectionCSV(const ReprojectionStats &stats, const std::string &filename);
+bool placeAnchor(TrackingResult &result, int frameIndex, const cv::Point2f &pixel, glm::vec3 &anchor);